@@ -0,0 +1,55 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Helpers shared by the benchmark sketches in bench/
+ * Each of the bench sources is a sketch of its own, build them with "make bench"
+ * They only use the Arduino and ESP APIs so they run on the device as well
+ */
+
+#ifndef EMSESP_BENCH_H
+#define EMSESP_BENCH_H
+
+#include <Arduino.h>
+
+// heap figures as reported by the ESP8266 core
+struct heap_snapshot {
+    uint32_t free_;
+    uint32_t max_block_;
+    uint8_t  frag_;
+
+    heap_snapshot()
+        : free_(ESP.getFreeHeap())
+        , max_block_(ESP.getMaxFreeBlockSize())
+        , frag_(ESP.getHeapFragmentation()) {
+    }
+};
+
+// convert a difference of two ESP.getCycleCount() readings into nanoseconds
+inline uint32_t bench_ns(uint32_t cycles) {
+    return (static_cast<uint64_t>(cycles) * 1000) / ESP.getCpuFreqMHz();
+}
+
+// callback used for all registered commands, counts so the calls can't be optimized away
+static volatile uint32_t bench_calls = 0;
+
+inline void bench_callback(const char * data __attribute__((unused)), const int8_t id) {
+    bench_calls += id;
+}
+
+#endif
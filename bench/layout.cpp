@@ -0,0 +1,119 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Prints sizeof, alignof and padding of the structs we store in the containers,
+ * followed by the field by field layout of the command struct (see layout.h)
+ * On a 64 bit host the numbers are about twice what the ESP8266 uses, build
+ * with "make layout32" to get the ESP8266 data model (ILP32, 8 byte long long/double)
+ */
+
+#include "bench.h"
+
+#include "command.h"
+#include "layout.h"
+
+using namespace emsesp;
+
+template <typename T>
+struct align_in_struct {
+    char c;
+    T    t;
+};
+
+// a field of type T starts at this offset in a struct, which isn't always alignof(T) on 32 bit x86
+#define STRUCT_ALIGN(type) offsetof(align_in_struct<type>, t)
+
+// std::function makes the struct non standard-layout, offsetof() still works with gcc
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+
+template <typename F>
+struct cmd_layout {
+    typedef MQTTCmdFunctionT<F> S;
+
+    static const layout_field fields[7];
+
+    // what sizeof() adds on top of all fields is padding
+    static size_t field_size() {
+        size_t size = 0;
+        for (const auto & f : fields) {
+            size += f.size_;
+        }
+        return size;
+    }
+};
+
+template <typename F>
+const layout_field cmd_layout<F>::fields[7] = {EMSESP_LAYOUT_FIELD(S, dummy2_),
+                                               EMSESP_LAYOUT_FIELD(S, options_),
+                                               EMSESP_LAYOUT_FIELD(S, cmd_),
+                                               EMSESP_LAYOUT_FIELD(S, mqtt_cmdfunction_),
+                                               EMSESP_LAYOUT_FIELD(S, device_type_),
+                                               EMSESP_LAYOUT_FIELD(S, dummy1_),
+                                               EMSESP_LAYOUT_FIELD(S, options_size_)};
+
+// fields is 0 when we can't see the members
+static void report(const char * name, size_t size, size_t align, size_t fields) {
+    if (fields) {
+        Serial.printf("%s,%u,%u,%u,%u", name, (unsigned)size, (unsigned)align, (unsigned)fields, (unsigned)(size - fields));
+    } else {
+        Serial.printf("%s,%u,%u,,", name, (unsigned)size, (unsigned)align);
+    }
+    Serial.println();
+}
+
+#define REPORT(type, fields) report(#type, sizeof(type), alignof(type), fields)
+#define LAYOUT(f) layout_print(Serial, "MQTTCmdFunctionT<" #f ">", sizeof(cmd_layout<f>::S), alignof(cmd_layout<f>::S), cmd_layout<f>::fields)
+
+void setup() {
+    Serial.println("# data model");
+    Serial.printf("# pointer %u, long %u, long long %u (aligned %u), double %u (aligned %u)",
+                  (unsigned)sizeof(void *),
+                  (unsigned)sizeof(long),
+                  (unsigned)sizeof(long long),
+                  (unsigned)STRUCT_ALIGN(long long),
+                  (unsigned)sizeof(double),
+                  (unsigned)STRUCT_ALIGN(double));
+    Serial.println();
+    Serial.println("# the ESP8266 is pointer 4, long 4, long long 8 (aligned 8), double 8 (aligned 8)");
+
+    Serial.println("struct,sizeof,alignof,fields,padding");
+    REPORT(mqtt_cmd_std_function, 0);
+    REPORT(mqtt_cmd_c_function, sizeof(mqtt_cmd_c_function));
+    REPORT(mqtt_cmd_callback, 0);
+    REPORT(mqtt_cmd_delegate, 0);
+    REPORT(mqtt_cmd_handler, 0);
+    REPORT(MQTTCmdFunctionT<mqtt_cmd_std_function>, cmd_layout<mqtt_cmd_std_function>::field_size());
+    REPORT(MQTTCmdFunctionT<mqtt_cmd_c_function>, cmd_layout<mqtt_cmd_c_function>::field_size());
+    REPORT(MQTTCmdFunctionT<mqtt_cmd_callback>, cmd_layout<mqtt_cmd_callback>::field_size());
+    REPORT(MQTTCmdFunctionT<mqtt_cmd_delegate>, cmd_layout<mqtt_cmd_delegate>::field_size());
+    REPORT(MQTTCmdFunctionT<mqtt_cmd_handler>, cmd_layout<mqtt_cmd_handler>::field_size());
+    REPORT(Command, 0);
+    REPORT(emsesp::array<Command::MQTTCmdFunction>, 0);
+    REPORT(emsesp::queue<Command::MQTTCmdFunction>, 0);
+
+    Serial.println();
+    LAYOUT(mqtt_cmd_std_function);
+    LAYOUT(mqtt_cmd_c_function);
+    LAYOUT(mqtt_cmd_callback);
+    LAYOUT(mqtt_cmd_delegate);
+    LAYOUT(mqtt_cmd_handler);
+}
+
+void loop() {
+}
@@ -0,0 +1,374 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Runs every container x callback style x number of elements in one go
+ * and prints a CSV with the heap used and the time to fill and walk the container.
+ * This replaces editing the commented out alternatives in main.cpp and command.h
+ */
+
+#include "bench.h"
+
+#include "command.h"
+#include "pool.h"
+
+using namespace emsesp;
+
+static const char str_hi[] PROGMEM   = "hi";
+static const char str_tf3[] PROGMEM  = "tf3";
+static const char str_off[] PROGMEM  = "off";
+static const char str_flow[] PROGMEM = "flow";
+static const char str_buf[] PROGMEM  = "buffered";
+
+static const __FlashStringHelper * const options_v1[] PROGMEM = {FPSTR(str_off), nullptr};
+static const __FlashStringHelper * const options_v3[] PROGMEM = {FPSTR(str_off), FPSTR(str_flow), FPSTR(str_buf), nullptr};
+
+// same mix as setup() in main.cpp
+template <typename F>
+static MQTTCmdFunctionT<F> make_entry(uint8_t i, const F & f) {
+    MQTTCmdFunctionT<F> mf;
+    mf.device_type_      = i;
+    mf.dummy1_           = 10;
+    mf.dummy2_           = FPSTR(str_hi);
+    mf.cmd_              = FPSTR(str_tf3);
+    mf.mqtt_cmdfunction_ = f;
+    mf.options_          = (i < 20) ? options_v3 : ((i < 40) ? options_v1 : nullptr);
+    mf.options_size_     = 0;
+    if (mf.options_ != nullptr) {
+        while (mf.options_[mf.options_size_]) {
+            mf.options_size_++;
+        }
+    }
+    return mf;
+}
+
+//
+// one wrapper per container, constructed with the number of elements that will be pushed
+// entries are moved in, the same for all containers
+//
+
+template <typename E>
+struct bench_vector {
+    static const char * name() {
+        return "std::vector";
+    }
+    std::vector<E> c_;
+    bench_vector(uint8_t elements __attribute__((unused))) {
+    }
+    bool push(E & e) {
+        c_.push_back(std::move(e));
+        return true;
+    }
+    template <typename V>
+    void visit(V v) {
+        for (auto & e : c_) {
+            v(e);
+        }
+    }
+};
+
+template <typename E>
+struct bench_list {
+    static const char * name() {
+        return "std::list";
+    }
+    std::list<E> c_;
+    bench_list(uint8_t elements __attribute__((unused))) {
+    }
+    bool push(E & e) {
+        c_.push_back(std::move(e));
+        return true;
+    }
+    template <typename V>
+    void visit(V v) {
+        for (auto & e : c_) {
+            v(e);
+        }
+    }
+};
+
+// std::list with its nodes from one pool, a node is the entry plus the next and prev pointers
+template <typename E>
+struct bench_list_pool {
+    static const char * name() {
+        return "std::list(pool)";
+    }
+    emsesp::pool                            pool_;
+    std::list<E, emsesp::pool_allocator<E>> c_;
+    bench_list_pool(uint8_t elements)
+        : pool_(sizeof(E) + 2 * sizeof(void *), elements)
+        , c_(emsesp::pool_allocator<E>(pool_)) {
+    }
+    bool push(E & e) {
+        c_.push_back(std::move(e));
+        return true;
+    }
+    template <typename V>
+    void visit(V v) {
+        for (auto & e : c_) {
+            v(e);
+        }
+    }
+};
+
+template <typename E>
+struct bench_queue {
+    // std::queue hides its container, this opens it up so we can walk it
+    struct iterable_queue : std::queue<E> {
+        using std::queue<E>::c;
+    };
+    static const char * name() {
+        return "std::queue";
+    }
+    iterable_queue c_;
+    bench_queue(uint8_t elements __attribute__((unused))) {
+    }
+    bool push(E & e) {
+        c_.push(std::move(e));
+        return true;
+    }
+    template <typename V>
+    void visit(V v) {
+        for (auto & e : c_.c) {
+            v(e);
+        }
+    }
+};
+
+template <typename E>
+struct bench_deque {
+    static const char * name() {
+        return "std::deque";
+    }
+    std::deque<E> c_;
+    bench_deque(uint8_t elements __attribute__((unused))) {
+    }
+    bool push(E & e) {
+        c_.push_back(std::move(e));
+        return true;
+    }
+    template <typename V>
+    void visit(V v) {
+        for (auto & e : c_) {
+            v(e);
+        }
+    }
+};
+
+template <typename E>
+struct bench_emsesp_queue {
+    static const char * name() {
+        return "emsesp::queue";
+    }
+    emsesp::queue<E> c_;
+    bench_emsesp_queue(uint8_t elements)
+        : c_(elements) {
+    }
+    bool push(E & e) {
+        return c_.push(std::move(e));
+    }
+    template <typename V>
+    void visit(V v) {
+        for (auto & e : c_) {
+            v(e);
+        }
+    }
+};
+
+// allocated up front for all elements
+template <typename E>
+struct bench_emsesp_array {
+    static const char * name() {
+        return "emsesp::array(n)";
+    }
+    emsesp::array<E> c_;
+    bench_emsesp_array(uint8_t elements)
+        : c_(elements, 255, 16) {
+    }
+    bool push(E & e) {
+        return c_.push(std::move(e)) >= 0;
+    }
+    template <typename V>
+    void visit(V v) {
+        for (auto & e : c_) {
+            v(e);
+        }
+    }
+};
+
+// the default, starting at 16 and growing by 16
+template <typename E>
+struct bench_emsesp_array_grow : bench_emsesp_array<E> {
+    static const char * name() {
+        return "emsesp::array(16+16)";
+    }
+    bench_emsesp_array_grow(uint8_t elements __attribute__((unused)))
+        : bench_emsesp_array<E>(16) {
+    }
+};
+
+// no heap, one static table per element type that is emptied for every run
+template <typename E>
+struct bench_emsesp_static_array {
+    static const char * name() {
+        return "emsesp::static_array";
+    }
+    emsesp::static_array<E, NUM_ENTRIES> & c_;
+    bench_emsesp_static_array(uint8_t elements __attribute__((unused)))
+        : c_(table()) {
+        c_.clear();
+    }
+    ~bench_emsesp_static_array() {
+        c_.clear();
+    }
+    static emsesp::static_array<E, NUM_ENTRIES> & table() {
+        static emsesp::static_array<E, NUM_ENTRIES> t;
+        return t;
+    }
+    bool push(E & e) {
+        return c_.push(std::move(e)) >= 0;
+    }
+    template <typename V>
+    void visit(V v) {
+        for (auto & e : c_) {
+            v(e);
+        }
+    }
+};
+
+// grows in chunks of 16 that are never moved
+template <typename E>
+struct bench_emsesp_segmented_array {
+    static const char * name() {
+        return "emsesp::segmented_array(16)";
+    }
+    emsesp::segmented_array<E, 16> c_;
+    bench_emsesp_segmented_array(uint8_t elements __attribute__((unused))) {
+    }
+    bool push(E & e) {
+        return c_.push(std::move(e)) >= 0;
+    }
+    template <typename V>
+    void visit(V v) {
+        for (auto & e : c_) {
+            v(e);
+        }
+    }
+};
+
+//
+// the runner
+//
+
+template <template <typename> class C, typename F>
+static void run(const char * style, const F & f, uint8_t elements) {
+    using E = MQTTCmdFunctionT<F>;
+
+    uint32_t free_before = ESP.getFreeHeap();
+    uint32_t push_cycles;
+    uint32_t iterate_cycles;
+    uint8_t  pushed = 0;
+    uint32_t used;
+    uint8_t  frag;
+    uint32_t max_block;
+
+    {
+        C<E> container(elements);
+
+        uint32_t start = ESP.getCycleCount();
+        for (uint8_t i = 1; i <= elements; i++) {
+            E mf = make_entry(i, f);
+            if (container.push(mf)) {
+                pushed++;
+            }
+        }
+        push_cycles = ESP.getCycleCount() - start;
+
+        heap_snapshot filled;
+        used      = free_before - filled.free_;
+        frag      = filled.frag_;
+        max_block = filled.max_block_;
+
+        start = ESP.getCycleCount();
+        container.visit([](E & e) { e.mqtt_cmdfunction_(reinterpret_cast<const char *>(e.cmd_), e.device_type_); });
+        iterate_cycles = ESP.getCycleCount() - start;
+    }
+
+    // container,callback,elements,pushed,sizeof,bytes_used,bytes_per_element,frag,max_block,leaked,push_ns,iterate_ns
+    Serial.printf("%s,%s,%d,%d,%d,%u,%u,%d,%u,%u,%u,%u\r\n",
+                  C<E>::name(),
+                  style,
+                  elements,
+                  pushed,
+                  (int)sizeof(E),
+                  used,
+                  pushed ? used / pushed : 0,
+                  frag,
+                  max_block,
+                  free_before - ESP.getFreeHeap(),
+                  bench_ns(push_cycles),
+                  bench_ns(iterate_cycles));
+}
+
+// the delegate calls a method on this, like a device object in EMS-ESP
+struct bench_device {
+    void command(const char * data, const int8_t id) {
+        bench_callback(data, id);
+    }
+};
+
+static bench_device device;
+
+// the handler row stores the index of bench_callback in this table
+static const mqtt_cmd_c_function bench_handlers_P[] PROGMEM = {bench_callback};
+
+template <template <typename> class C>
+static void run_callbacks(uint8_t elements) {
+    run<C>("function", mqtt_cmd_std_function(bench_callback), elements);
+    run<C>("lambda", mqtt_cmd_std_function([](const char * data, const int8_t id) { bench_callback(data, id); }), elements);
+    run<C>("bind", mqtt_cmd_std_function(std::bind(&bench_callback, std::placeholders::_1, std::placeholders::_2)), elements);
+    run<C>("pointer", static_cast<mqtt_cmd_c_function>(bench_callback), elements);
+    run<C>("callback", mqtt_cmd_callback([](const char * data, const int8_t id) { bench_callback(data, id); }), elements);
+    run<C>("delegate", mqtt_cmd_delegate::create<bench_device, &bench_device::command>(&device), elements);
+    run<C>("handler", mqtt_cmd_handler(bench_callback), elements);
+}
+
+void setup() {
+    // 255 elements of std::vector with std::bind needs more than the 40KB heap, and the std:: containers cannot survive new returning nullptr
+    static const uint8_t counts[] = {10, 50, 100, 150, NUM_ENTRIES};
+
+    Serial.begin(115200);
+    mqtt_cmd_handlers::table().begin(bench_handlers_P);
+    Serial.println("container,callback,elements,pushed,sizeof,bytes_used,bytes_per_element,frag,max_block,leaked,push_ns,iterate_ns");
+
+    for (uint8_t elements : counts) {
+        run_callbacks<bench_vector>(elements);
+        run_callbacks<bench_list>(elements);
+        run_callbacks<bench_list_pool>(elements);
+        run_callbacks<bench_queue>(elements);
+        run_callbacks<bench_deque>(elements);
+        run_callbacks<bench_emsesp_queue>(elements);
+        run_callbacks<bench_emsesp_array>(elements);
+        run_callbacks<bench_emsesp_array_grow>(elements);
+        run_callbacks<bench_emsesp_static_array>(elements);
+        run_callbacks<bench_emsesp_segmented_array>(elements);
+    }
+}
+
+void loop() {
+}
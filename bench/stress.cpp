@@ -0,0 +1,269 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Long running fragmentation test. A random but repeatable workload mixes
+ * device discovery (command registration), telegram queue churn, string
+ * formatting and device value arrays growing, like months of uptime would.
+ * The same workload runs for each registry container and reserve() setting
+ * and the CSV tracks free heap, largest free block and fragmentation over time.
+ *   sample,config,iteration,free_heap,max_block,frag
+ *   summary,config,min_free,min_max_block,max_frag,end_free,end_max_block,end_frag,rejected
+ */
+
+#include "bench.h"
+
+#include "command.h"
+
+using namespace emsesp;
+
+#ifndef BENCH_STRESS_ITERATIONS
+#define BENCH_STRESS_ITERATIONS 1000000UL
+#endif
+#define BENCH_STRESS_SAMPLES 50
+// at least 1, so fewer iterations than samples still works
+#define BENCH_STRESS_SAMPLE_EVERY ((BENCH_STRESS_ITERATIONS / BENCH_STRESS_SAMPLES) ? (BENCH_STRESS_ITERATIONS / BENCH_STRESS_SAMPLES) : 1)
+
+#define MAX_DEVICES 6
+#define MAX_COMMANDS 30
+#define MAX_VALUES 48
+#define TELEGRAM_QUEUE_SIZE 20
+
+static const char str_cmd[] PROGMEM   = "wwcirculation";
+static const char str_value[] PROGMEM = "selected flow temperature of the boiler";
+
+// repeatable random numbers, so every config sees the same workload
+static uint32_t rnd_state;
+static uint32_t rnd(uint32_t range) {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state % range;
+}
+
+using Cmd = MQTTCmdFunctionT<mqtt_cmd_c_function>;
+
+struct DeviceValue {
+    uint8_t                     type_;
+    void *                      value_p_;
+    const __FlashStringHelper * name_;
+};
+
+struct Telegram {
+    uint8_t   src_;
+    uint8_t   length_;
+    uint8_t * message_data_;
+};
+
+// how the registry tables are stored
+enum class Store : uint8_t { ARRAY, VECTOR };
+
+struct Config {
+    const char * name_;
+    Store        store_;
+    uint8_t      elements_;
+    uint8_t      max_;
+    uint8_t      grow_;
+};
+
+// a discovered device with its commands and values
+class Device {
+  public:
+    Device(const Config & config)
+        : config_(config)
+        , values_(8, MAX_VALUES, 8) {
+        if (config_.store_ == Store::ARRAY) {
+            array_ = new emsesp::array<Cmd>(config_.elements_, config_.max_, config_.grow_);
+        } else {
+            vector_ = new std::vector<Cmd>();
+        }
+    }
+
+    ~Device() {
+        delete array_;
+        delete vector_;
+    }
+
+    bool register_cmd(Cmd & cmd) {
+        if (array_) {
+            return array_->push(cmd) >= 0;
+        }
+        // the container itself couldn't be allocated
+        if (!vector_) {
+            return false;
+        }
+        if (vector_->size() >= config_.max_) {
+            return false;
+        }
+        vector_->push_back(cmd);
+        return true;
+    }
+
+    // false when out of memory, a device with all its values is not an error
+    bool add_value(DeviceValue & dv) {
+        if (values_.size() >= MAX_VALUES) {
+            return true;
+        }
+        return values_.push(dv) >= 0;
+    }
+
+  private:
+    const Config &             config_;
+    emsesp::array<Cmd> *       array_  = nullptr;
+    std::vector<Cmd> *         vector_ = nullptr;
+    emsesp::array<DeviceValue> values_;
+};
+
+static Device *                  devices[MAX_DEVICES];
+static emsesp::queue<Telegram> * telegrams;
+static uint32_t                  rejected;
+
+static void command_callback(const char * data, const int8_t id) {
+    bench_callback(data, id);
+}
+
+static void discover_device(const Config & config) {
+    uint8_t slot = rnd(MAX_DEVICES);
+    delete devices[slot]; // replaces an old device
+    devices[slot] = new Device(config);
+    if (!devices[slot]) {
+        rejected++;
+        return;
+    }
+
+    uint8_t num = 5 + rnd(MAX_COMMANDS - 5);
+    for (uint8_t i = 0; i < num; i++) {
+        Cmd cmd;
+        cmd.device_type_      = slot;
+        cmd.dummy1_           = i;
+        cmd.dummy2_           = nullptr;
+        cmd.options_          = nullptr;
+        cmd.options_size_     = 0;
+        cmd.cmd_              = FPSTR(str_cmd);
+        cmd.mqtt_cmdfunction_ = command_callback;
+        if (!devices[slot]->register_cmd(cmd)) {
+            rejected++;
+        }
+    }
+}
+
+static void telegram_churn() {
+    if (rnd(2) && (telegrams->size() < TELEGRAM_QUEUE_SIZE)) {
+        Telegram t;
+        t.src_          = rnd(0x7F);
+        t.length_       = 4 + rnd(28);
+        t.message_data_ = new uint8_t[t.length_];
+        if (!t.message_data_ || !telegrams->push(t)) {
+            delete[] t.message_data_;
+            rejected++;
+        }
+    } else if (!telegrams->empty()) {
+        Telegram t = telegrams->pop();
+        delete[] t.message_data_;
+    }
+}
+
+static void format_string() {
+    std::string s = uuid::read_flash_string(FPSTR(str_value));
+    s += " ";
+    s += std::to_string(rnd(1000));
+    bench_calls += s.size();
+}
+
+static void grow_values() {
+    Device * device = devices[rnd(MAX_DEVICES)];
+    if (!device) {
+        return;
+    }
+    DeviceValue dv;
+    dv.type_    = rnd(8);
+    dv.value_p_ = nullptr;
+    dv.name_    = FPSTR(str_value);
+    if (!device->add_value(dv)) {
+        rejected++;
+    }
+}
+
+static void cleanup() {
+    for (uint8_t i = 0; i < MAX_DEVICES; i++) {
+        delete devices[i];
+        devices[i] = nullptr;
+    }
+    while (!telegrams->empty()) {
+        Telegram t = telegrams->pop();
+        delete[] t.message_data_;
+    }
+    delete telegrams;
+}
+
+static void run(const Config & config) {
+    uint32_t min_free      = UINT32_MAX;
+    uint32_t min_max_block = UINT32_MAX;
+    uint8_t  max_frag      = 0;
+
+    rnd_state = 0x2545F491;
+    rejected  = 0;
+    telegrams = new emsesp::queue<Telegram>(TELEGRAM_QUEUE_SIZE);
+
+    for (uint32_t i = 1; i <= BENCH_STRESS_ITERATIONS; i++) {
+        uint16_t r = rnd(1000);
+        if (r < 450) {
+            telegram_churn();
+        } else if (r < 850) {
+            format_string();
+        } else if (r < 999) {
+            grow_values();
+        } else {
+            discover_device(config);
+        }
+
+        if ((i % BENCH_STRESS_SAMPLE_EVERY) == 0) {
+            heap_snapshot heap;
+            Serial.printf("sample,%s,%u,%u,%u,%d\r\n", config.name_, i, heap.free_, heap.max_block_, heap.frag_);
+            min_free      = std::min(min_free, heap.free_);
+            min_max_block = std::min(min_max_block, heap.max_block_);
+            max_frag      = std::max(max_frag, heap.frag_);
+        }
+    }
+
+    heap_snapshot end;
+    Serial.printf("summary,%s,%u,%u,%d,%u,%u,%d,%u\r\n", config.name_, min_free, min_max_block, max_frag, end.free_, end.max_block_, end.frag_, rejected);
+
+    cleanup();
+}
+
+void setup() {
+    // reserve(elements, max, grow) settings to compare
+    static const Config configs[] = {
+        {"array(16,255,16)", Store::ARRAY, 16, 255, 16},
+        {"array(8,255,4)", Store::ARRAY, 8, 255, 4},
+        {"array(8,255,8)", Store::ARRAY, 8, 255, 8},
+        {"array(32,255,32)", Store::ARRAY, 32, 255, 32},
+        {"array(30,30,0)", Store::ARRAY, MAX_COMMANDS, MAX_COMMANDS, 0},
+        {"std::vector", Store::VECTOR, 0, 255, 0},
+    };
+
+    Serial.begin(115200);
+
+    for (const Config & config : configs) {
+        run(config);
+    }
+}
+
+void loop() {
+}
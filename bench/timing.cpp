@@ -0,0 +1,561 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Timing of every public operation of emsesp::queue and emsesp::array
+ * for different element sizes and number of elements.
+ * Each measurement is repeated, after a few warmup runs, and the CSV shows
+ * the min, median and 99th percentile in nanoseconds per operation.
+ * Look for ns/op growing with the count, those are the O(n) paths.
+ */
+
+#include "bench.h"
+
+#include "containers.h"
+
+#include <algorithm>
+
+#define BENCH_WARMUP 5
+#define BENCH_RUNS 101
+
+// element of N bytes
+template <uint8_t N>
+struct payload {
+    uint8_t data_[N];
+
+    payload() {
+    }
+    payload(uint8_t v) {
+        memset(data_, v, N);
+    }
+};
+
+static uint32_t samples[BENCH_RUNS];
+
+//
+// one struct per operation. run() sets up the container, times the operation
+// and returns the cycles it took. ops() is how many operations that was
+//
+
+template <typename E>
+struct queue_push {
+    static const char * name() {
+        return "queue::push";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::queue<E> q(count);
+        E                e(1);
+        uint32_t         start = ESP.getCycleCount();
+        for (uint8_t i = 0; i < count; i++) {
+            q.push(e);
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+template <typename E>
+struct queue_push_front {
+    static const char * name() {
+        return "queue::push_front";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::queue<E> q(count);
+        E                e(1);
+        uint32_t         start = ESP.getCycleCount();
+        for (uint8_t i = 0; i < count; i++) {
+            q.push_front(e);
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+// constructs the entry in place, nothing is copied
+template <typename E>
+struct queue_emplace {
+    static const char * name() {
+        return "queue::emplace";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::queue<E> q(count);
+        uint32_t         start = ESP.getCycleCount();
+        for (uint8_t i = 0; i < count; i++) {
+            q.emplace(1);
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+template <typename E>
+struct queue_emplace_front {
+    static const char * name() {
+        return "queue::emplace_front";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::queue<E> q(count);
+        uint32_t         start = ESP.getCycleCount();
+        for (uint8_t i = 0; i < count; i++) {
+            q.emplace_front(1);
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+template <typename E>
+struct queue_pop {
+    static const char * name() {
+        return "queue::pop";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::queue<E> q(count);
+        E                e(1);
+        for (uint8_t i = 0; i < count; i++) {
+            q.push(e);
+        }
+        uint32_t start = ESP.getCycleCount();
+        for (uint8_t i = 0; i < count; i++) {
+            e = q.pop();
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+template <typename E>
+struct queue_pop_front {
+    static const char * name() {
+        return "queue::pop_front";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::queue<E> q(count);
+        E                e(1);
+        for (uint8_t i = 0; i < count; i++) {
+            q.push(e);
+        }
+        uint32_t start = ESP.getCycleCount();
+        for (uint8_t i = 0; i < count; i++) {
+            e = q.pop_front();
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+template <typename E>
+struct queue_pop_back {
+    static const char * name() {
+        return "queue::pop_back";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::queue<E> q(count);
+        E                e(1);
+        for (uint8_t i = 0; i < count; i++) {
+            q.push(e);
+        }
+        uint32_t start = ESP.getCycleCount();
+        for (uint8_t i = 0; i < count; i++) {
+            e = q.pop_back();
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+template <typename E>
+struct queue_front {
+    static const char * name() {
+        return "queue::front";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::queue<E> q(count);
+        E                e(1);
+        for (uint8_t i = 0; i < count; i++) {
+            q.push(e);
+        }
+        volatile uint8_t sum   = 0;
+        uint32_t         start = ESP.getCycleCount();
+        for (uint8_t i = 0; i < count; i++) {
+            sum += q.front().data_[0];
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+template <typename E>
+struct queue_back {
+    static const char * name() {
+        return "queue::back";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::queue<E> q(count);
+        E                e(1);
+        for (uint8_t i = 0; i < count; i++) {
+            q.push(e);
+        }
+        volatile uint8_t sum   = 0;
+        uint32_t         start = ESP.getCycleCount();
+        for (uint8_t i = 0; i < count; i++) {
+            sum += q.back().data_[0];
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+template <typename E>
+struct queue_index {
+    static const char * name() {
+        return "queue::operator[]";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::queue<E> q(count);
+        E                e(1);
+        for (uint8_t i = 0; i < count; i++) {
+            q.push(e);
+        }
+        volatile uint8_t sum   = 0;
+        uint32_t         start = ESP.getCycleCount();
+        for (uint8_t i = 0; i < count; i++) {
+            sum += q[i].data_[0];
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+template <typename E>
+struct queue_iterate {
+    static const char * name() {
+        return "queue::iterate";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::queue<E> q(count);
+        E                e(1);
+        for (uint8_t i = 0; i < count; i++) {
+            q.push(e);
+        }
+        volatile uint8_t sum   = 0;
+        uint32_t         start = ESP.getCycleCount();
+        for (const E & v : q) {
+            sum += v.data_[0];
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+// the constructor allocates and the destructor frees the buffer
+template <typename E>
+struct queue_create {
+    static const char * name() {
+        return "queue::create+destroy";
+    }
+    static uint8_t ops(uint8_t count __attribute__((unused))) {
+        return 1;
+    }
+    static uint32_t run(uint8_t count) {
+        uint32_t start = ESP.getCycleCount();
+        {
+            emsesp::queue<E> q(count);
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+template <typename E>
+struct array_push {
+    static const char * name() {
+        return "array::push";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::array<E> a(count, 255, 16);
+        E                e(1);
+        uint32_t         start = ESP.getCycleCount();
+        for (uint8_t i = 0; i < count; i++) {
+            a.push(e);
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+template <typename E>
+struct array_emplace {
+    static const char * name() {
+        return "array::emplace";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::array<E> a(count, 255, 16);
+        uint32_t         start = ESP.getCycleCount();
+        for (uint8_t i = 0; i < count; i++) {
+            a.emplace(1);
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+// starting at the default size of 16 and growing by 16
+template <typename E>
+struct array_push_grow {
+    static const char * name() {
+        return "array::push(grow)";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::array<E> a;
+        E                e(1);
+        uint32_t         start = ESP.getCycleCount();
+        for (uint8_t i = 0; i < count; i++) {
+            a.push(e);
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+// growing a full array by one element, this copies every element. a full 255 can't grow
+template <typename E>
+struct array_resize {
+    static const char * name() {
+        return "array::resize";
+    }
+    static uint8_t ops(uint8_t count) {
+        return (count < 255) ? 1 : 0;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::array<E> a(count, 255, 16);
+        E                e(1);
+        for (uint8_t i = 0; i < count; i++) {
+            a.push(e);
+        }
+        uint32_t start = ESP.getCycleCount();
+        a.resize(count + 1);
+        return ESP.getCycleCount() - start;
+    }
+};
+
+// trimming an array that is half full down to its size, a single entry has nothing to trim
+template <typename E>
+struct array_shrink_to_fit {
+    static const char * name() {
+        return "array::shrink_to_fit";
+    }
+    static uint8_t ops(uint8_t count) {
+        return (count > 1) ? 1 : 0;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::array<E> a(count, 255, 16);
+        E                e(1);
+        for (uint8_t i = 0; i < count / 2; i++) {
+            a.push(e);
+        }
+        uint32_t start = ESP.getCycleCount();
+        a.shrink_to_fit();
+        return ESP.getCycleCount() - start;
+    }
+};
+
+// same as shrink_to_fit, and the array stops growing
+template <typename E>
+struct array_freeze {
+    static const char * name() {
+        return "array::freeze";
+    }
+    static uint8_t ops(uint8_t count) {
+        return (count > 1) ? 1 : 0;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::array<E> a(count, 255, 16);
+        E                e(1);
+        for (uint8_t i = 0; i < count / 2; i++) {
+            a.push(e);
+        }
+        uint32_t start = ESP.getCycleCount();
+        a.freeze();
+        return ESP.getCycleCount() - start;
+    }
+};
+
+template <typename E>
+struct array_index {
+    static const char * name() {
+        return "array::operator[]";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::array<E> a(count, 255, 16);
+        E                e(1);
+        for (uint8_t i = 0; i < count; i++) {
+            a.push(e);
+        }
+        volatile uint8_t sum   = 0;
+        uint32_t         start = ESP.getCycleCount();
+        for (uint8_t i = 0; i < count; i++) {
+            sum += a[i].data_[0];
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+template <typename E>
+struct array_iterate {
+    static const char * name() {
+        return "array::iterate";
+    }
+    static uint8_t ops(uint8_t count) {
+        return count;
+    }
+    static uint32_t run(uint8_t count) {
+        emsesp::array<E> a(count, 255, 16);
+        E                e(1);
+        for (uint8_t i = 0; i < count; i++) {
+            a.push(e);
+        }
+        volatile uint8_t sum   = 0;
+        uint32_t         start = ESP.getCycleCount();
+        for (const E & v : a) {
+            sum += v.data_[0];
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+template <typename E>
+struct array_create {
+    static const char * name() {
+        return "array::create+destroy";
+    }
+    static uint8_t ops(uint8_t count __attribute__((unused))) {
+        return 1;
+    }
+    static uint32_t run(uint8_t count) {
+        uint32_t start = ESP.getCycleCount();
+        {
+            emsesp::array<E> a(count, 255, 16);
+        }
+        return ESP.getCycleCount() - start;
+    }
+};
+
+//
+// the harness
+//
+
+template <template <typename> class Op, uint8_t N>
+static void measure(uint8_t count) {
+    using O = Op<payload<N>>;
+
+    uint8_t ops = O::ops(count);
+    if (ops == 0) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < BENCH_WARMUP; i++) {
+        O::run(count);
+    }
+    for (uint8_t i = 0; i < BENCH_RUNS; i++) {
+        samples[i] = bench_ns(O::run(count)) / ops;
+    }
+    std::sort(samples, samples + BENCH_RUNS);
+
+    // op,element_size,count,runs,min_ns,median_ns,p99_ns
+    Serial.printf("%s,%d,%d,%d,%u,%u,%u\r\n",
+                  O::name(),
+                  N,
+                  count,
+                  BENCH_RUNS,
+                  samples[0],
+                  samples[BENCH_RUNS / 2],
+                  samples[(BENCH_RUNS * 99) / 100]);
+}
+
+template <uint8_t N>
+static void measure_all(uint8_t count) {
+    measure<queue_push, N>(count);
+    measure<queue_push_front, N>(count);
+    measure<queue_emplace, N>(count);
+    measure<queue_emplace_front, N>(count);
+    measure<queue_pop, N>(count);
+    measure<queue_pop_front, N>(count);
+    measure<queue_pop_back, N>(count);
+    measure<queue_front, N>(count);
+    measure<queue_back, N>(count);
+    measure<queue_index, N>(count);
+    measure<queue_iterate, N>(count);
+    measure<queue_create, N>(count);
+    measure<array_push, N>(count);
+    measure<array_emplace, N>(count);
+    measure<array_push_grow, N>(count);
+    measure<array_resize, N>(count);
+    measure<array_shrink_to_fit, N>(count);
+    measure<array_freeze, N>(count);
+    measure<array_index, N>(count);
+    measure<array_iterate, N>(count);
+    measure<array_create, N>(count);
+}
+
+void setup() {
+    static const uint8_t counts[] = {1, 16, 64, 128, 255};
+
+    Serial.begin(115200);
+    Serial.println("op,element_size,count,runs,min_ns,median_ns,p99_ns");
+
+    for (uint8_t count : counts) {
+        measure_all<1>(count);
+        measure_all<4>(count);
+        measure_all<16>(count);
+        measure_all<64>(count);
+    }
+}
+
+void loop() {
+}
@@ -17,52 +17,176 @@
 
 #include <Arduino.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 
+#include <chrono>
 #include <string>
 
 NativeConsole Serial;
 
-/* millis() on C++ native could be
-for non-Arduino
-millis():
-#include <chrono>
-    auto start = std::chrono::system_clock::now();
-    auto end = std::chrono::system_clock::now();
-    diff = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-*/
+// time runs in one of two modes, chosen on the command line (see usage())
+//  virtual: starts at 0 and only moves when delay() is called or a loop() has finished,
+//           which makes runs repeatable and much faster than real time. the default
+//  real:    millis() and micros() follow the host's monotonic clock and delay() sleeps
+static bool                                  __real_time = false;
+static unsigned long long                    __micros    = 0;    // virtual clock
+static unsigned long                         __tick_us   = 1000; // virtual time a loop() takes
+static unsigned long                         __run_ms    = 10 * 1000;
+static bool                                  __histogram = false;
+static std::chrono::steady_clock::time_point __start     = std::chrono::steady_clock::now();
+
+// host time spent in each loop(), bucket n counts calls that took less than 2^n us
+static const uint8_t LOOP_BUCKETS = 24;
+static uint32_t      __loop_histogram[LOOP_BUCKETS];
+static uint32_t      __loop_calls  = 0;
+static uint64_t      __loop_max_ns = 0;
+
+static bool __output_pins[256];
+static int  __output_level[256];
+
+static void usage(const char * name) {
+    fprintf(stderr,
+            "usage: %s [--real-time] [--run <ms>] [--tick <us>] [--histogram]\n"
+            "  --real-time  follow the host clock instead of virtual time\n"
+            "  --run        how long to keep calling loop(), default 10000 ms\n"
+            "  --tick       virtual time added after each loop(), default 1000 us\n"
+            "  --histogram  print how long each loop() took on the host\n",
+            name);
+    exit(1);
+}
 
-static unsigned long __millis = 0;
-static bool          __output_pins[256];
-static int           __output_level[256];
+static void timed_loop() {
+    auto start = std::chrono::steady_clock::now();
+    loop();
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    uint8_t bucket = 0;
+    while ((bucket < LOOP_BUCKETS - 1) && ((1000ULL << bucket) <= ns)) {
+        bucket++;
+    }
+    __loop_histogram[bucket]++;
+    __loop_calls++;
+    if (ns > __loop_max_ns) {
+        __loop_max_ns = ns;
+    }
+
+    if (!__real_time) {
+        __micros += __tick_us;
+    }
+}
 
-int main(int argc __attribute__((unused)), char * argv[] __attribute__((unused))) {
+static void print_histogram() {
+    Serial.println();
+    Serial.printf("loop() latency: %u calls in %lu ms (%s time), max %llu us",
+                  __loop_calls,
+                  millis(),
+                  __real_time ? "real" : "virtual",
+                  (unsigned long long)(__loop_max_ns / 1000));
+    Serial.println();
+    for (uint8_t i = 0; i < LOOP_BUCKETS; i++) {
+        if (__loop_histogram[i]) {
+            Serial.printf("  < %8lu us: %u", 1UL << i, __loop_histogram[i]);
+            Serial.println();
+        }
+    }
+}
+
+int main(int argc, char * argv[]) {
     memset(__output_pins, 0, sizeof(__output_pins));
     memset(__output_level, 0, sizeof(__output_level));
 
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--real-time")) {
+            __real_time = true;
+        } else if (!strcmp(argv[i], "--run") && (i + 1 < argc)) {
+            __run_ms = strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--tick") && (i + 1 < argc)) {
+            __tick_us = strtoul(argv[++i], nullptr, 10);
+            if (__tick_us == 0) {
+                usage(argv[0]); // virtual time would never move on
+            }
+        } else if (!strcmp(argv[i], "--histogram")) {
+            __histogram = true;
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    ESP.heapBegin();
+
+    // HEAP_TRACE=<file> records all allocations, see heap_trace.h
+    const char * trace = getenv("HEAP_TRACE");
+    if (trace) {
+        heap_trace_begin(trace);
+    }
+
+    __start = std::chrono::steady_clock::now();
+
     setup();
-    loop(); // run once
+    timed_loop(); // run once
 
-    static unsigned long __cycles = 0;
+    while (millis() <= __run_ms) {
+        timed_loop();
+    }
 
-    while (millis() <= 10 * 1000 && __cycles++ <= 10 * 1000) {
-        loop();
+    if (__histogram) {
+        print_histogram();
     }
 
+    heap_trace_end();
+
     return 0;
 }
 
 unsigned long millis() {
-    return __millis;
+    return micros() / 1000;
+}
+
+unsigned long micros() {
+    if (__real_time) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - __start).count();
+    }
+    return __micros;
 }
 
 void delay(unsigned long millis) {
-    // __millis += millis;
+    if (__real_time) {
+        usleep(millis * 1000);
+    } else {
+        __micros += millis * 1000ULL;
+    }
 }
 
 void yield(void) {
 }
 
+// like the ESP8266 core, only goes to the heap when the text doesn't fit on the stack
+size_t Print::printf(const char * format, ...) {
+    va_list arg;
+    char    temp[64];
+    char *  buffer = temp;
+
+    va_start(arg, format);
+    size_t len = vsnprintf(temp, sizeof(temp), format, arg);
+    va_end(arg);
+
+    if (len > sizeof(temp) - 1) {
+        buffer = new char[len + 1];
+        if (!buffer) {
+            return 0;
+        }
+        va_start(arg, format);
+        vsnprintf(buffer, len + 1, format, arg);
+        va_end(arg);
+    }
+    len = write((const uint8_t *)buffer, len);
+    if (buffer != temp) {
+        delete[] buffer;
+    }
+    return len;
+}
+
 int snprintf_P(char * str, size_t size, const char * format, ...) {
     va_list ap;
 
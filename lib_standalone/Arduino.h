@@ -133,6 +133,7 @@ class Print {
     size_t println(unsigned long value) {
         return print(std::to_string(value).c_str()) + println();
     }
+    size_t       printf(const char * format, ...) __attribute__((format(printf, 2, 3)));
     virtual void flush(){};
 };
 
@@ -196,6 +197,7 @@ class NativeConsole : public Stream {
 extern NativeConsole Serial;
 
 unsigned long millis();
+unsigned long micros();
 
 void delay(unsigned long millis);
 
@@ -205,5 +207,7 @@ void setup(void);
 void loop(void);
 
 #include "WString.h"
+#include "Esp.h"
+#include "heap_trace.h"
 
 #endif
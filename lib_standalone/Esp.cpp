@@ -0,0 +1,153 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+
+#include "umm_heap.h"
+#include "heap_trace.h"
+
+#include <chrono>
+#include <new>
+
+// the real glibc allocator, used for everything the C/C++ runtime sets up before main()
+extern "C" {
+void * __libc_malloc(size_t size);
+void * __libc_calloc(size_t nmemb, size_t size);
+void * __libc_realloc(void * ptr, size_t size);
+void   __libc_free(void * ptr);
+}
+
+EspClass ESP;
+
+// once main() starts every allocation is served from the emulated ESP8266 heap
+alignas(8) static uint8_t __heap_arena[STANDALONE_HEAP_SIZE + UmmHeap::BLOCK_SIZE];
+alignas(UmmHeap) static uint8_t __heap_storage[sizeof(UmmHeap)];
+static UmmHeap * __heap_model = nullptr;
+static UmmHeap * __heap       = nullptr; // set when routing allocations to the model
+
+// the model is created on first use, so ESP calls made during static init see the real figures
+static UmmHeap * __umm() {
+    if (!__heap_model) {
+        __heap_model = new (__heap_storage) UmmHeap(__heap_arena, sizeof(__heap_arena));
+    }
+    return __heap_model;
+}
+
+extern "C" {
+
+void * malloc(size_t size) {
+    if (__heap) {
+        void * ptr = __heap->malloc(size);
+        heap_trace_event(HEAP_TRACE_MALLOC, size, __heap->block_index(ptr), 0);
+        return ptr;
+    }
+    return __libc_malloc(size);
+}
+
+void * calloc(size_t nmemb, size_t size) {
+    if (__heap) {
+        void * ptr = __heap->calloc(nmemb, size);
+        heap_trace_event(HEAP_TRACE_MALLOC, nmemb * size, __heap->block_index(ptr), 0);
+        return ptr;
+    }
+    return __libc_calloc(nmemb, size);
+}
+
+void * realloc(void * ptr, size_t size) {
+    if (__heap && (ptr == nullptr || __heap->contains(ptr))) {
+        uint16_t old     = __heap->block_index(ptr);
+        void *   new_ptr = __heap->realloc(ptr, size);
+        heap_trace_event(HEAP_TRACE_REALLOC, size, __heap->block_index(new_ptr), old);
+        return new_ptr;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+void free(void * ptr) {
+    if (__heap && __heap->contains(ptr)) {
+        heap_trace_event(HEAP_TRACE_FREE, 0, __heap->block_index(ptr), 0);
+        __heap->free(ptr);
+    } else {
+        __libc_free(ptr);
+    }
+}
+
+} // extern "C"
+
+// same as the ESP8266 core, new and delete are plain malloc and free
+// so new can return nullptr when the heap is full (build with -fcheck-new)
+void * operator new(size_t size) {
+    return malloc(size);
+}
+
+void * operator new[](size_t size) {
+    return malloc(size);
+}
+
+void * operator new(size_t size, const std::nothrow_t &) noexcept {
+    return malloc(size);
+}
+
+void * operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return malloc(size);
+}
+
+void operator delete(void * ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void * ptr) noexcept {
+    free(ptr);
+}
+
+void EspClass::heapBegin() {
+    __heap = __umm();
+}
+
+uint32_t EspClass::getFreeHeap() {
+    return __umm()->free_size();
+}
+
+uint32_t EspClass::getMaxFreeBlockSize() {
+    return __umm()->max_block_size();
+}
+
+uint8_t EspClass::getHeapFragmentation() {
+    return __umm()->fragmentation();
+}
+
+void EspClass::getHeapStats(uint32_t * free, uint32_t * max, uint8_t * frag) {
+    if (free) {
+        *free = getFreeHeap();
+    }
+    if (max) {
+        *max = getMaxFreeBlockSize();
+    }
+    if (frag) {
+        *frag = getHeapFragmentation();
+    }
+}
+
+uint32_t EspClass::getCycleCount() {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    return static_cast<uint32_t>(static_cast<uint64_t>(ns) * STANDALONE_CPU_MHZ / 1000);
+}
+
+uint8_t EspClass::getCpuFreqMHz() {
+    return STANDALONE_CPU_MHZ;
+}
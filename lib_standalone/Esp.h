@@ -0,0 +1,56 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host replacement for the ESP8266 core's EspClass
+ * Heap figures come from the malloc/free/new/delete shim in Esp.cpp which, once
+ * main() has started, serves every allocation from an umm_malloc model (umm_heap.h)
+ */
+
+#ifndef ESP_H_
+#define ESP_H_
+
+#include <cstdint>
+
+// size of the emulated heap in bytes, roughly what an ESP8266 has left after booting
+#ifndef STANDALONE_HEAP_SIZE
+#define STANDALONE_HEAP_SIZE 40960
+#endif
+
+#ifndef STANDALONE_CPU_MHZ
+#define STANDALONE_CPU_MHZ 160
+#endif
+
+class EspClass {
+  public:
+    // starts counting allocations, called from main() before setup()
+    void heapBegin();
+
+    uint32_t getFreeHeap();
+    uint32_t getMaxFreeBlockSize();
+    uint8_t  getHeapFragmentation();
+    void     getHeapStats(uint32_t * free = nullptr, uint32_t * max = nullptr, uint8_t * frag = nullptr);
+
+    // CPU cycles of a 160MHz ESP8266, derived from the host clock. wraps at 32 bits like the device
+    uint32_t getCycleCount();
+    uint8_t  getCpuFreqMHz();
+};
+
+extern EspClass ESP;
+
+#endif
@@ -64,5 +64,6 @@ size_t strlcat(char * dst, const char * src, size_t siz);
 #define strncpy_P strncpy
 #define strcmp_P strcmp
 #define strcpy_P strcpy
+#define memcpy_P memcpy
 
 #endif
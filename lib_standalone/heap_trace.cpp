@@ -0,0 +1,136 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+
+#include "heap_trace.h"
+#include "umm_heap.h"
+
+#include <chrono>
+#include <fcntl.h>
+
+// the tracer must not allocate itself, so plain file descriptors and a static buffer
+static int      __trace_fd = -1;
+static uint8_t  __trace_buffer[4096];
+static size_t   __trace_used = 0;
+static uint64_t __trace_start;
+
+// tag names are kept by pointer, index 0 is untagged
+#define HEAP_TRACE_MAX_TAGS 255
+static const char * __trace_tags[HEAP_TRACE_MAX_TAGS + 1];
+static bool         __trace_tag_written[HEAP_TRACE_MAX_TAGS + 1];
+static uint8_t      __trace_num_tags   = 0;
+static uint8_t      __trace_active_tag = 0;
+
+static uint64_t __trace_now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void __trace_flush() {
+    if (__trace_used && (::write(__trace_fd, __trace_buffer, __trace_used) < 0)) {
+        ::close(__trace_fd);
+        __trace_fd = -1;
+    }
+    __trace_used = 0;
+}
+
+static void __trace_write(const void * data, size_t size) {
+    const uint8_t * p = static_cast<const uint8_t *>(data);
+    while (size && __trace_fd >= 0) {
+        size_t n = std::min(size, sizeof(__trace_buffer) - __trace_used);
+        memcpy(__trace_buffer + __trace_used, p, n);
+        __trace_used += n;
+        p += n;
+        size -= n;
+        if (__trace_used == sizeof(__trace_buffer)) {
+            __trace_flush();
+        }
+    }
+}
+
+static void __trace_record(HeapTraceOp op, uint32_t size, uint16_t block, uint16_t old) {
+    HeapTraceRecord r;
+    r.time_  = __trace_now() - __trace_start;
+    r.size_  = size;
+    r.block_ = block;
+    r.old_   = old;
+    r.op_    = op;
+    r.tag_   = __trace_active_tag;
+    __trace_write(&r, sizeof(r));
+}
+
+bool heap_trace_begin(const char * path) {
+    heap_trace_end();
+
+    __trace_fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (__trace_fd < 0) {
+        return false;
+    }
+    __trace_start = __trace_now();
+    memset(__trace_tag_written, 0, sizeof(__trace_tag_written));
+
+    HeapTraceHeader header;
+    header.magic_      = HEAP_TRACE_MAGIC;
+    header.version_    = HEAP_TRACE_VERSION;
+    header.block_size_ = UmmHeap::BLOCK_SIZE;
+    header.heap_size_  = STANDALONE_HEAP_SIZE;
+    __trace_write(&header, sizeof(header));
+    return true;
+}
+
+void heap_trace_end() {
+    if (__trace_fd >= 0) {
+        __trace_flush();
+        ::close(__trace_fd);
+        __trace_fd = -1;
+    }
+}
+
+void heap_trace_event(HeapTraceOp op, uint32_t size, uint16_t block, uint16_t old) {
+    if (__trace_fd < 0) {
+        return;
+    }
+
+    // the name of a tag goes into the file the first time it's used
+    if (__trace_active_tag && !__trace_tag_written[__trace_active_tag]) {
+        const char * name = __trace_tags[__trace_active_tag];
+        __trace_record(HEAP_TRACE_TAG, strlen(name), 0, 0);
+        __trace_write(name, strlen(name));
+        __trace_tag_written[__trace_active_tag] = true;
+    }
+
+    __trace_record(op, size, block, old);
+}
+
+HeapTraceTag::HeapTraceTag(const char * name)
+    : previous_(__trace_active_tag) {
+    for (uint16_t i = 1; i <= __trace_num_tags; i++) {
+        if (__trace_tags[i] == name || !strcmp(__trace_tags[i], name)) {
+            __trace_active_tag = i;
+            return;
+        }
+    }
+    if (__trace_num_tags < HEAP_TRACE_MAX_TAGS) {
+        __trace_tags[++__trace_num_tags] = name;
+        __trace_active_tag               = __trace_num_tags;
+    }
+}
+
+HeapTraceTag::~HeapTraceTag() {
+    __trace_active_tag = previous_;
+}
@@ -0,0 +1,78 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Records every malloc/free/realloc on the emulated heap into a binary file,
+ * which tools/heap_replay.cpp can replay against other allocator models.
+ * Set HEAP_TRACE=<file> in the environment to trace a whole run, or call
+ * heap_trace_begin()/heap_trace_end() around the part of interest.
+ *
+ * File layout, all little endian:
+ *   HeapTraceHeader
+ *   HeapTraceRecord...  op HEAP_TRACE_TAG is followed by size_ bytes of tag name
+ * Pointers are stored as the umm block index, 0 is nullptr.
+ */
+
+#ifndef HEAP_TRACE_H_
+#define HEAP_TRACE_H_
+
+#include <cstdint>
+
+#define HEAP_TRACE_MAGIC 0x54484D55 // "UMHT"
+#define HEAP_TRACE_VERSION 1
+
+enum HeapTraceOp : uint8_t { HEAP_TRACE_MALLOC = 'm', HEAP_TRACE_FREE = 'f', HEAP_TRACE_REALLOC = 'r', HEAP_TRACE_TAG = 't' };
+
+struct __attribute__((packed)) HeapTraceHeader {
+    uint32_t magic_;
+    uint8_t  version_;
+    uint8_t  block_size_;
+    uint32_t heap_size_;
+};
+
+// 14 bytes per event
+struct __attribute__((packed)) HeapTraceRecord {
+    uint32_t time_;  // microseconds since heap_trace_begin()
+    uint32_t size_;  // requested size, tag name length for HEAP_TRACE_TAG
+    uint16_t block_; // result of malloc/realloc, the freed block for free
+    uint16_t old_;   // realloc: the block that was passed in
+    uint8_t  op_;
+    uint8_t  tag_;   // callsite tag, 0 is untagged
+};
+
+bool heap_trace_begin(const char * path);
+void heap_trace_end();
+
+// called by the allocator shim in Esp.cpp
+void heap_trace_event(HeapTraceOp op, uint32_t size, uint16_t block, uint16_t old);
+
+// tags all allocations until the end of the current scope
+class HeapTraceTag {
+  public:
+    HeapTraceTag(const char * name);
+    ~HeapTraceTag();
+
+  private:
+    uint8_t previous_;
+};
+
+#define HEAP_TRACE_TAG_CONCAT_(a, b) a##b
+#define HEAP_TRACE_TAG_CONCAT(a, b) HEAP_TRACE_TAG_CONCAT_(a, b)
+#define HEAP_TRACE_SCOPE(name) HeapTraceTag HEAP_TRACE_TAG_CONCAT(__heap_trace_tag_, __LINE__)(name)
+
+#endif
@@ -0,0 +1,337 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "umm_heap.h"
+
+#include <cstring>
+
+UmmHeap::UmmHeap(void * arena, size_t size, bool first_fit)
+    : first_fit_(first_fit) {
+    // the device returns 4 byte aligned pointers, we place the arena so the
+    // data part of every block is 8 byte aligned which keeps the host happy
+    uintptr_t start = reinterpret_cast<uintptr_t>(arena);
+    uintptr_t first = ((start + HEADER_SIZE + 7) & ~static_cast<uintptr_t>(7)) - HEADER_SIZE;
+    size -= (first - start);
+
+    heap_      = reinterpret_cast<umm_block *>(first);
+    numblocks_ = (size / BLOCK_SIZE > MAX_BLOCKS) ? MAX_BLOCKS : size / BLOCK_SIZE;
+    init();
+}
+
+// set up a blank heap, one free block spanning everything between block 0 and the last block
+void UmmHeap::init() {
+    const uint16_t block_last = numblocks_ - 1;
+
+    memset(heap_, 0, numblocks_ * BLOCK_SIZE);
+
+    // the 0th block is the head of the free list and points to the 1st
+    nblock(0) = 1;
+    nfree(0)  = 1;
+    pfree(0)  = 1;
+
+    // the 1st block is free and spans the whole heap
+    nblock(1) = block_last | FREELIST_MASK;
+    nfree(1)  = 0;
+    pblock(1) = 0;
+    pfree(1)  = 0;
+
+    // the last block is marked as used and terminates the heap
+    nblock(block_last) = 0;
+    pblock(block_last) = 1;
+}
+
+size_t UmmHeap::blocks(size_t size) {
+    // the first block holds the header and the first 4 bytes of data
+    if (size <= sizeof(((umm_block *)0)->body)) {
+        return 1;
+    }
+
+    // the last block may be shared with the header of the next one
+    size -= (1 + sizeof(((umm_block *)0)->body));
+    return (2 + size / BLOCK_SIZE);
+}
+
+bool UmmHeap::contains(const void * ptr) const {
+    const uint8_t * p = static_cast<const uint8_t *>(ptr);
+    return (p >= reinterpret_cast<const uint8_t *>(heap_)) && (p < reinterpret_cast<const uint8_t *>(heap_ + numblocks_));
+}
+
+uint16_t UmmHeap::block_index(const void * ptr) const {
+    if (ptr == nullptr) {
+        return 0;
+    }
+    return (static_cast<const uint8_t *>(ptr) - reinterpret_cast<const uint8_t *>(heap_)) / BLOCK_SIZE;
+}
+
+size_t UmmHeap::usable_size(const void * ptr) const {
+    uint16_t c = block_index(ptr);
+    return ((nblock(c) & BLOCKNO_MASK) - c) * BLOCK_SIZE - HEADER_SIZE;
+}
+
+// split c into two, the new block at c + blocks gets the new_freemask
+void UmmHeap::split_block(uint16_t c, uint16_t blocks, uint16_t new_freemask) {
+    nblock(c + blocks)               = (nblock(c) & BLOCKNO_MASK) | new_freemask;
+    pblock(c + blocks)               = c;
+    pblock(nblock(c) & BLOCKNO_MASK) = (c + blocks);
+    nblock(c)                        = (c + blocks);
+}
+
+void UmmHeap::disconnect_from_free_list(uint16_t c) {
+    nfree(pfree(c)) = nfree(c);
+    pfree(nfree(c)) = pfree(c);
+    nblock(c) &= (~FREELIST_MASK);
+}
+
+// merge c with the next block, if that one is free
+void UmmHeap::assimilate_up(uint16_t c) {
+    if (nblock(nblock(c)) & FREELIST_MASK) {
+        disconnect_from_free_list(nblock(c));
+        pblock(nblock(nblock(c)) & BLOCKNO_MASK) = c;
+        nblock(c)                                = nblock(nblock(c)) & BLOCKNO_MASK;
+    }
+}
+
+// merge c into the previous block, returns the merged block
+uint16_t UmmHeap::assimilate_down(uint16_t c, uint16_t freemask) {
+    nblock(pblock(c)) = nblock(c) | freemask;
+    pblock(nblock(c)) = pblock(c);
+    return pblock(c);
+}
+
+void * UmmHeap::malloc(size_t size) {
+    if (size == 0) {
+        return nullptr;
+    }
+
+    // counted in size_t, more blocks than the heap has would wrap around in 16 bits
+    size_t needed = UmmHeap::blocks(size);
+    if (needed >= numblocks_) {
+        return nullptr; // out of memory
+    }
+
+    uint16_t blocks    = needed;
+    uint16_t blockSize = 0;
+    uint16_t bestSize  = 0x7FFF;
+    uint16_t bestBlock = nfree(0);
+    uint16_t cf        = nfree(0);
+
+    // walk the free list, either until the first block that is big enough
+    // or all the way to find the smallest one that fits
+    while (cf) {
+        blockSize = (nblock(cf) & BLOCKNO_MASK) - cf;
+        if (first_fit_) {
+            if (blockSize >= blocks) {
+                break;
+            }
+        } else if ((blockSize >= blocks) && (blockSize < bestSize)) {
+            bestBlock = cf;
+            bestSize  = blockSize;
+        }
+        cf = nfree(cf);
+    }
+
+    if (!first_fit_ && (bestSize != 0x7FFF)) {
+        cf        = bestBlock;
+        blockSize = bestSize;
+    }
+
+    if (!(nblock(cf) & BLOCKNO_MASK) || (blockSize < blocks)) {
+        return nullptr; // out of memory
+    }
+
+    if (blockSize == blocks) {
+        // exact fit
+        disconnect_from_free_list(cf);
+    } else {
+        // take the front of the free block, the rest stays in the free list in the same place
+        split_block(cf, blocks, FREELIST_MASK);
+
+        nfree(pfree(cf))   = cf + blocks;
+        pfree(cf + blocks) = pfree(cf);
+        pfree(nfree(cf))   = cf + blocks;
+        nfree(cf + blocks) = nfree(cf);
+    }
+
+    return data(cf);
+}
+
+void * UmmHeap::calloc(size_t num, size_t size) {
+    void * ptr = malloc(num * size);
+    if (ptr) {
+        memset(ptr, 0, num * size);
+    }
+    return ptr;
+}
+
+void UmmHeap::free(void * ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+
+    uint16_t c = block_index(ptr);
+
+    assimilate_up(c);
+
+    if (nblock(pblock(c)) & FREELIST_MASK) {
+        // previous block is free, so just grow that one
+        assimilate_down(c, FREELIST_MASK);
+    } else {
+        // new free block goes to the head of the free list
+        pfree(nfree(0)) = c;
+        nfree(c)        = nfree(0);
+        pfree(c)        = 0;
+        nfree(0)        = c;
+        nblock(c) |= FREELIST_MASK;
+    }
+}
+
+// same as umm_realloc built with UMM_REALLOC_MINIMIZE_COPY, try to grow into
+// the neighbouring free blocks before falling back to malloc/copy/free
+void * UmmHeap::realloc(void * ptr, size_t size) {
+    if (ptr == nullptr) {
+        return malloc(size);
+    }
+    if (size == 0) {
+        free(ptr);
+        return nullptr;
+    }
+
+    // too big for the heap, ptr is left as it is
+    size_t needed = UmmHeap::blocks(size);
+    if (needed >= numblocks_) {
+        return nullptr;
+    }
+
+    uint16_t blocks        = needed;
+    uint16_t c             = block_index(ptr);
+    uint16_t blockSize     = nblock(c) - c;
+    size_t   curSize       = (blockSize * BLOCK_SIZE) - HEADER_SIZE;
+    uint16_t nextBlockSize = 0;
+    uint16_t prevBlockSize = 0;
+
+    if (nblock(nblock(c)) & FREELIST_MASK) {
+        nextBlockSize = (nblock(nblock(c)) & BLOCKNO_MASK) - nblock(c);
+    }
+    if (nblock(pblock(c)) & FREELIST_MASK) {
+        prevBlockSize = c - pblock(c);
+    }
+
+    if (blockSize >= blocks) {
+        // shrinking or the same size, the tail is split off below
+    } else if ((blockSize + nextBlockSize) >= blocks) {
+        assimilate_up(c);
+        blockSize += nextBlockSize;
+    } else if ((prevBlockSize + blockSize) >= blocks) {
+        disconnect_from_free_list(pblock(c));
+        c = assimilate_down(c, 0);
+        memmove(data(c), ptr, curSize);
+        ptr = data(c);
+        blockSize += prevBlockSize;
+    } else if ((prevBlockSize + blockSize + nextBlockSize) >= blocks) {
+        assimilate_up(c);
+        disconnect_from_free_list(pblock(c));
+        c = assimilate_down(c, 0);
+        memmove(data(c), ptr, curSize);
+        ptr = data(c);
+        blockSize += prevBlockSize + nextBlockSize;
+    } else {
+        void * oldptr = ptr;
+        ptr           = malloc(size);
+        if (ptr) {
+            memcpy(ptr, oldptr, curSize);
+            free(oldptr);
+        }
+        return ptr;
+    }
+
+    // give back what we don't need
+    if (blockSize > blocks) {
+        split_block(c, blocks, 0);
+        free(data(c + blocks));
+    }
+
+    return ptr;
+}
+
+UmmHeap::Info UmmHeap::info() const {
+    Info     info;
+    uint16_t blockNo = 0;
+
+    memset(&info, 0, sizeof(info));
+
+    // skip block 0, it is the head of the free list
+    blockNo = nblock(blockNo) & BLOCKNO_MASK;
+
+    while (nblock(blockNo) & BLOCKNO_MASK) {
+        uint32_t curBlocks = (nblock(blockNo) & BLOCKNO_MASK) - blockNo;
+
+        ++info.totalBlocks;
+        if (nblock(blockNo) & FREELIST_MASK) {
+            ++info.freeEntries;
+            info.freeBlocks += curBlocks;
+            info.freeSize2 += static_cast<uint64_t>(curBlocks * BLOCK_SIZE) * (curBlocks * BLOCK_SIZE);
+            if (info.maxFreeContiguousBlocks < curBlocks) {
+                info.maxFreeContiguousBlocks = curBlocks;
+            }
+        } else {
+            ++info.usedEntries;
+            info.usedBlocks += curBlocks;
+        }
+
+        blockNo = nblock(blockNo) & BLOCKNO_MASK;
+    }
+
+    return info;
+}
+
+uint32_t UmmHeap::free_size() const {
+    return info().freeBlocks * BLOCK_SIZE;
+}
+
+uint32_t UmmHeap::max_block_size() const {
+    return info().maxFreeContiguousBlocks * BLOCK_SIZE;
+}
+
+// integer square root, as used by the core
+static uint32_t sqrt32(uint64_t n) {
+    uint64_t x = 0;
+    uint64_t b = static_cast<uint64_t>(1) << 62;
+    while (b > n) {
+        b >>= 2;
+    }
+    while (b) {
+        if (n >= x + b) {
+            n -= x + b;
+            x = (x >> 1) + b;
+        } else {
+            x >>= 1;
+        }
+        b >>= 2;
+    }
+    return x;
+}
+
+// same formula as EspClass::getHeapFragmentation() on the ESP8266
+uint8_t UmmHeap::fragmentation() const {
+    Info     i         = info();
+    uint32_t free_size = i.freeBlocks * BLOCK_SIZE;
+    if (free_size == 0) {
+        return 0;
+    }
+    return 100 - (sqrt32(i.freeSize2) * 100) / free_size;
+}
@@ -0,0 +1,127 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host model of the umm_malloc heap used by the ESP8266 Arduino core
+ * Based on https://github.com/rhempel/umm_malloc as configured in core 2.7.x
+ *
+ * The heap is an array of 8 byte blocks. Every allocation takes a 4 byte header
+ * (next/prev block index, top bit of next marks a free block) plus as many
+ * blocks as needed for the data, so the figures match what the device reports.
+ * Free blocks use their body to link into the free list, block 0 is the list head.
+ */
+
+#ifndef UMM_HEAP_H_
+#define UMM_HEAP_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// the ESP8266 core builds umm_malloc with UMM_BEST_FIT and UMM_REALLOC_MINIMIZE_COPY, define UMM_FIRST_FIT to compare
+#if defined(UMM_FIRST_FIT)
+#define UMM_DEFAULT_FIRST_FIT true
+#else
+#define UMM_DEFAULT_FIRST_FIT false
+#endif
+
+class UmmHeap {
+  public:
+    struct Info {
+        uint32_t totalBlocks;
+        uint32_t usedEntries;
+        uint32_t usedBlocks;
+        uint32_t freeEntries;
+        uint32_t freeBlocks;
+        uint32_t maxFreeContiguousBlocks;
+        uint64_t freeSize2; // sum of the squares of all free block sizes in bytes
+    };
+
+    static const size_t   BLOCK_SIZE  = 8;
+    static const size_t   HEADER_SIZE = 4;
+    static const uint16_t MAX_BLOCKS  = 0x7FFF;
+
+    // arena is the raw memory to manage, it doesn't need to be aligned
+    UmmHeap(void * arena, size_t size, bool first_fit = UMM_DEFAULT_FIRST_FIT);
+
+    void   init();
+    void * malloc(size_t size);
+    void * calloc(size_t num, size_t size);
+    void * realloc(void * ptr, size_t size);
+    void   free(void * ptr);
+
+    bool   contains(const void * ptr) const;
+    size_t usable_size(const void * ptr) const;
+
+    // index of the block holding ptr, 0 (the free list head) for nullptr
+    uint16_t block_index(const void * ptr) const;
+
+    // number of blocks umm_malloc uses for a request of size bytes, can be more than the heap has
+    static size_t blocks(size_t size);
+
+    // walks the heap like umm_info()
+    Info info() const;
+
+    // the figures EspClass reports on the ESP8266
+    uint32_t free_size() const;
+    uint32_t max_block_size() const;
+    uint8_t  fragmentation() const;
+
+  private:
+    struct umm_ptr {
+        uint16_t next;
+        uint16_t prev;
+    };
+
+    struct umm_block {
+        umm_ptr header;
+        union {
+            umm_ptr free;
+            uint8_t data[BLOCK_SIZE - sizeof(umm_ptr)];
+        } body;
+    };
+
+    static const uint16_t FREELIST_MASK = 0x8000;
+    static const uint16_t BLOCKNO_MASK  = 0x7FFF;
+
+    umm_block * heap_;
+    uint16_t    numblocks_;
+    bool        first_fit_;
+
+    uint16_t & nblock(uint16_t c) const {
+        return heap_[c].header.next;
+    }
+    uint16_t & pblock(uint16_t c) const {
+        return heap_[c].header.prev;
+    }
+    uint16_t & nfree(uint16_t c) const {
+        return heap_[c].body.free.next;
+    }
+    uint16_t & pfree(uint16_t c) const {
+        return heap_[c].body.free.prev;
+    }
+    void * data(uint16_t c) const {
+        return heap_[c].body.data;
+    }
+
+    void     split_block(uint16_t c, uint16_t blocks, uint16_t new_freemask);
+    void     disconnect_from_free_list(uint16_t c);
+    void     assimilate_up(uint16_t c);
+    uint16_t assimilate_down(uint16_t c, uint16_t freemask);
+};
+
+#endif
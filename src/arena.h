@@ -0,0 +1,234 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Bump pointer arena for data that is set up once in setup() and kept until reboot
+ * begin() takes one block from the heap, allocate() hands out the next bytes of it
+ * without a heap header, nothing is freed on its own. seal() gives the unused tail back
+ * to the heap once registration is done, after that the arena is read-only
+ */
+
+#ifndef EMSESP_ARENA_H
+#define EMSESP_ARENA_H
+
+#include <Arduino.h>
+
+#include <new>
+#include <utility>
+
+#if defined EMSESP_ASSERT
+#include <assert.h>
+#endif
+
+// seal() relies on realloc() shrinking a block in place. the ESP8266 core builds umm_malloc
+// with UMM_REALLOC_MINIMIZE_COPY, which does, and so does the standalone heap model.
+// UMM_REALLOC_DEFRAG moves a shrinking block down into a free block before it
+#if defined(ESP8266) && defined(__has_include)
+#if __has_include(<umm_malloc/umm_malloc_cfg.h>)
+#include <umm_malloc/umm_malloc_cfg.h>
+#if defined(UMM_REALLOC_DEFRAG)
+#error "emsesp::arena needs umm_malloc built with UMM_REALLOC_MINIMIZE_COPY"
+#endif
+#endif
+#endif
+
+namespace emsesp {
+
+class arena {
+  public:
+    arena() = default;
+
+    ~arena() {
+        free(mem_);
+    }
+
+    arena(const arena &) = delete;
+    arena & operator=(const arena &) = delete;
+
+    // takes capacity bytes from the heap, call as early as possible so the
+    // arena ends up at the start of the heap. false if there wasn't enough memory
+    bool begin(size_t capacity) {
+        if (mem_ != nullptr) {
+            return false;
+        }
+        mem_ = (uint8_t *)malloc(capacity);
+        if (mem_ == nullptr) {
+            return false;
+        }
+        capacity_ = capacity;
+        used_     = 0;
+        sealed_   = false;
+        return true;
+    }
+
+    // size bytes aligned to align, nullptr when full or sealed
+    void * allocate(size_t size, size_t align = alignof(void *)) {
+        if (mem_ == nullptr || sealed_) {
+            return nullptr;
+        }
+        uintptr_t start = ((uintptr_t)(mem_ + used_) + align - 1) & ~(uintptr_t)(align - 1);
+        size_t    end   = (start - (uintptr_t)mem_) + size;
+        if (end > capacity_) {
+            failed_++;
+            return nullptr;
+        }
+        used_ = end;
+        count_++;
+        return (void *)start;
+    }
+
+    // constructs a T in the arena, nullptr when it didn't fit
+    template <typename T, class... Args>
+    T * create(Args &&... args) {
+        void * p = allocate(sizeof(T), alignof(T));
+        return p ? new (p) T(std::forward<Args>(args)...) : nullptr;
+    }
+
+    // give the unused tail back to the heap and make the arena read-only
+    // umm_malloc shrinks the block in place, so everything allocated from the arena stays where it is
+    void seal() {
+        if (mem_ == nullptr || sealed_) {
+            return;
+        }
+        sealed_ = true;
+        if (used_ == 0) {
+            free(mem_);
+            mem_      = nullptr;
+            capacity_ = 0;
+        } else if (used_ < capacity_) {
+            void * p = realloc(mem_, used_);
+#ifdef EMSESP_ASSERT
+            assert(p == nullptr || p == mem_);
+#endif
+            // if it had moved mem_ is already freed, follow the block so it isn't freed twice
+            if (p != nullptr) {
+                mem_      = (uint8_t *)p;
+                capacity_ = used_;
+            }
+        }
+    }
+
+    bool owns(const void * p) const {
+        return (p >= mem_) && (p < mem_ + capacity_);
+    }
+
+    size_t used() const {
+        return used_;
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    bool sealed() const {
+        return sealed_;
+    }
+
+    size_t printTo(Print & p) const {
+        char s[100];
+        snprintf_P(s,
+                   sizeof(s),
+                   PSTR("%u allocations, %u of %u bytes used, %u failed%s"),
+                   count_,
+                   (unsigned)used_,
+                   (unsigned)capacity_,
+                   failed_,
+                   sealed_ ? ", sealed" : "");
+        return p.print(s);
+    }
+
+  private:
+    uint8_t * mem_      = nullptr;
+    size_t    capacity_ = 0;
+    size_t    used_     = 0;
+    uint16_t  count_    = 0; // number of allocate() calls that succeeded
+    uint16_t  failed_   = 0;
+    bool      sealed_   = false;
+};
+
+// allocator for emsesp::queue and emsesp::array that takes the buffer from an arena
+// nothing is given back, so size the container with its final size up front.
+// growing copies the entries to a new part of the arena and leaves the old one unused
+class arena_allocator {
+  public:
+    explicit arena_allocator(arena & a)
+        : arena_(&a) {
+    }
+
+    void * allocate(size_t size) {
+        return arena_->allocate(size);
+    }
+
+    void deallocate(void * p __attribute__((unused)), size_t size __attribute__((unused))) {
+    }
+
+    void * reallocate(void * p, size_t size, size_t new_size) {
+        if (new_size <= size) {
+            return p;
+        }
+        void * pn = arena_->allocate(new_size);
+        if (pn != nullptr && p != nullptr) {
+            memcpy(pn, p, size);
+        }
+        return pn;
+    }
+
+  private:
+    arena * arena_;
+};
+
+// takes from the arena while it is open and has room, from the heap otherwise
+// for data set up at boot that may come before the arena was started or after it was sealed
+class arena_heap_allocator {
+  public:
+    explicit arena_heap_allocator(arena & a)
+        : arena_(&a) {
+    }
+
+    void * allocate(size_t size) {
+        void * p = arena_->allocate(size);
+        return p ? p : malloc(size);
+    }
+
+    void deallocate(void * p, size_t size __attribute__((unused))) {
+        if (!arena_->owns(p)) {
+            free(p);
+        }
+    }
+
+    void * reallocate(void * p, size_t size, size_t new_size) {
+        if (!arena_->owns(p)) {
+            return realloc(p, new_size);
+        }
+        if (new_size <= size) {
+            return p;
+        }
+        void * pn = allocate(new_size);
+        if (pn != nullptr) {
+            memcpy(pn, p, size);
+        }
+        return pn;
+    }
+
+  private:
+    arena * arena_;
+};
+
+} // namespace emsesp
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Callback that keeps the callable inside the object, a std::function without the heap
+ * Based on the small_task idea of examples/lib/ustd/functional.h, but without the vtable:
+ * the object is an invoker plus N bytes, and calling it is one indirect call.
+ * A plain function pointer is its own invoker, so it is called the same as a bare pointer.
+ * Anything that fits in N bytes and can be copied with memcpy is stored inline (function
+ * pointers, lambdas capturing this or a few values). Anything else fails to compile,
+ * unless Heap is true, then it is copied to the heap instead
+ */
+
+#ifndef EMSESP_CALLBACK_H
+#define EMSESP_CALLBACK_H
+
+#include <Arduino.h>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "containers.h"
+
+namespace emsesp {
+
+// what a callback holds besides its signature, the invoker and N bytes for the callable
+// without the heap it is a plain struct, so a callback is copied and moved with memcpy.
+// data_ starts out zeroed, callables smaller than N leave the rest of it that way
+template <size_t N, bool Heap>
+struct callback_storage {
+    void (*invoke_)() = nullptr;
+    typename std::aligned_storage<N, alignof(void *)>::type data_{};
+
+    void set_manager(bool (*)(void *, const void *)) {
+    }
+};
+
+// with the heap, manage_ copies (or deletes) the callable that data_ points to
+template <size_t N>
+struct callback_storage<N, true> {
+    void (*invoke_)() = nullptr;
+    typename std::aligned_storage<N, alignof(void *)>::type data_{};
+    bool (*manage_)(void * dst, const void * src) = nullptr;
+
+    callback_storage() = default;
+
+    callback_storage(const callback_storage & o)
+        : invoke_(o.invoke_)
+        , manage_(o.manage_) {
+        if (manage_ == nullptr) {
+            data_ = o.data_;
+        } else if (!manage_(&data_, &o.data_)) {
+            invoke_ = nullptr; // out of memory, the copy is empty
+            manage_ = nullptr;
+        }
+    }
+
+    callback_storage(callback_storage && o)
+        : invoke_(o.invoke_)
+        , data_(o.data_)
+        , manage_(o.manage_) {
+        o.invoke_ = nullptr;
+        o.manage_ = nullptr;
+    }
+
+    ~callback_storage() {
+        if (manage_ != nullptr) {
+            manage_(&data_, nullptr);
+        }
+    }
+
+    callback_storage & operator=(callback_storage && o) {
+        if (this != &o) {
+            this->~callback_storage();
+            new (this) callback_storage(std::move(o));
+        }
+        return *this;
+    }
+
+    callback_storage & operator=(const callback_storage & o) {
+        if (this != &o) {
+            callback_storage c(o);
+            *this = std::move(c);
+        }
+        return *this;
+    }
+
+    void set_manager(bool (*manage)(void *, const void *)) {
+        manage_ = manage;
+    }
+};
+
+template <typename Sig, size_t N = 2 * sizeof(void *), bool Heap = false>
+class callback;
+
+// Sig is the signature e.g. void(const char *, const int8_t)
+// N is the room for the callable, the default fits a lambda capturing this and one more pointer
+// Heap allows callables that don't fit, they are then copied to the heap
+template <typename R, typename... Args, size_t N, bool Heap>
+class callback<R(Args...), N, Heap> : private callback_storage<N, Heap> {
+  private:
+    using invoker = R (*)(const void *, Args...);
+
+    // stored inline when it fits and needs no copy constructor or destructor
+    template <typename C>
+    struct fits : std::integral_constant<bool, (sizeof(C) <= N) && (alignof(C) <= alignof(void *)) && is_trivially_relocatable<C>::value> {};
+
+    template <typename C>
+    static R invoke_inline(const void * data, Args... args) {
+        return (*static_cast<C *>(const_cast<void *>(data)))(std::forward<Args>(args)...);
+    }
+
+    template <typename C>
+    static R invoke_heap(const void * data, Args... args) {
+        return (**static_cast<C * const *>(data))(std::forward<Args>(args)...);
+    }
+
+    // copies the callable of src to dst, or deletes the one of dst when src is nullptr
+    // false if there was no memory for the copy
+    template <typename C>
+    static bool manage_heap(void * dst, const void * src) {
+        if (src == nullptr) {
+            delete *static_cast<C **>(dst);
+            return true;
+        }
+        C * f                   = new C(**static_cast<C * const *>(src));
+        *static_cast<C **>(dst) = f;
+        return f != nullptr;
+    }
+
+    template <typename C, typename G>
+    void store(G && g, std::true_type) {
+        new (&this->data_) C(std::forward<G>(g));
+        this->invoke_ = reinterpret_cast<void (*)()>(static_cast<invoker>(&invoke_inline<C>));
+    }
+
+    template <typename C, typename G>
+    void store(G && g, std::false_type) {
+        static_assert(Heap && sizeof(C) > 0, "callable doesn't fit in the callback, raise N or allow the heap");
+        static_assert(N >= sizeof(void *), "callback needs room for a pointer to use the heap");
+        C * f = new C(std::forward<G>(g));
+        if (f == nullptr) {
+            return; // out of memory, the callback stays empty
+        }
+        *reinterpret_cast<C **>(&this->data_) = f;
+        this->invoke_                          = reinterpret_cast<void (*)()>(static_cast<invoker>(&invoke_heap<C>));
+        this->set_manager(&manage_heap<C>);
+    }
+
+  public:
+    callback() = default;
+
+    callback(std::nullptr_t) {
+    }
+
+    // kept in invoke_ and called directly, without an invoker in between.
+    // the copy in data_ marks it. data_ is zeroed when empty or for a captureless
+    // lambda, and no other callable can hold the address of its own invoker
+    callback(R (*f)(Args...)) {
+        static_assert(N >= sizeof(f), "callback needs room for a function pointer");
+        if (f != nullptr) {
+            this->invoke_ = reinterpret_cast<void (*)()>(f);
+            memcpy(&this->data_, &this->invoke_, sizeof(this->invoke_));
+        }
+    }
+
+    template <typename G, typename C = typename std::decay<G>::type, typename = typename std::enable_if<!std::is_same<C, callback>::value>::type>
+    callback(G && g) {
+        store<C>(std::forward<G>(g), fits<C>());
+    }
+
+    R operator()(Args... args) const {
+        void (*f)();
+        memcpy(&f, &this->data_, sizeof(f));
+        if (f == this->invoke_) {
+            return reinterpret_cast<R (*)(Args...)>(f)(std::forward<Args>(args)...);
+        }
+        return reinterpret_cast<invoker>(this->invoke_)(&this->data_, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const {
+        return this->invoke_ != nullptr;
+    }
+};
+
+} // namespace emsesp
+
+#endif
@@ -18,23 +18,16 @@ void Command::register_mqtt_cmd(uint8_t                             device_type,
                                 const __FlashStringHelper * const * options,
                                 const __FlashStringHelper *         cmd,
                                 mqtt_cmdfunction_p                  f) {
-    MQTTCmdFunction mf;
-    mf.device_type_      = device_type;
-    mf.dummy1_           = dummy1;
-    mf.dummy2_           = dummy2;
-    mf.cmd_              = cmd;
-    mf.mqtt_cmdfunction_ = f; // 2 - with using std::function or 3 with normal C function pointer
-
-    mf.options_      = options;
-    mf.options_size_ = 0;
+    HEAP_TRACE_SCOPE("register_mqtt_cmd");
+
+    // count #options
+    uint8_t options_size = 0;
     if (options != nullptr) {
-        // count #options
-        uint8_t i = 0;
-        while (options[i++]) {
-            mf.options_size_++;
+        while (options[options_size]) {
+            options_size++;
         };
         Serial.print("Got options size:");
-        Serial.print(mf.options_size_);
+        Serial.print(options_size);
         Serial.print(" ");
     }
 
@@ -48,7 +41,11 @@ void Command::register_mqtt_cmd(uint8_t                             device_type,
 
     // mqtt_cmdfunctions().push(mf); // emsesp::queue, emsesp::array, std::queue
 
-    mqtt_cmdfunctions_->push(mf); // emsesp::array
+    // 2 - with using std::function or 3 with normal C function pointer, moved in so it's never copied
+    int i = mqtt_cmdfunctions_->emplace(device_type, dummy1, dummy2, options, options_size, cmd, std::move(f)); // emsesp::array, emsesp::static_array
+    if (i >= 0) {
+        index_cmd(device_type, cmd, i);
+    }
 
     // mqtt_cmdfunctions_.push(mf); // emsesp::queue
 
@@ -93,15 +90,61 @@ void Command::print(uint32_t mem_used) {
     Serial.print(", total mem used = ");
     Serial.print(mem_used);
     Serial.print(", size of struct = ");
-    Serial.print(sizeof(MQTTCmdFunction));
-#ifndef STANDALONE
+    Serial.print(sizeof((*mqtt_cmdfunctions_)[0])); // the type that is stored, MQTTCmdFunction_P for the flash table
     Serial.print(", size per element = ");
     Serial.print(mem_used / size_elements);
-#endif
     Serial.println();
     Serial.println();
 }
 
+int Command::find(uint8_t device_type, const char * cmd) const {
+    int i = find_entry(device_type, cmd);
+    return ((i >= 0) && cmd_enabled(i)) ? i : -1;
+}
+
+// index of the command whether it is enabled or not, -1 if there is none
+int Command::find_entry(uint8_t device_type, const char * cmd) const {
+    auto match = [&](uint8_t entry) {
+        const auto & mf = (*mqtt_cmdfunctions_)[entry];
+        return (mf.device_type_ == device_type) && (strcmp_P(cmd, reinterpret_cast<PGM_P>(mf.cmd_)) == 0);
+    };
+    uint8_t i = cmd_index_.find(hash_cmd(device_type, cmd), match);
+    if (i != cmd_index_.NOT_FOUND) {
+        return i;
+    }
+    // some commands aren't in the index, look at all of them
+    if (cmd_index_incomplete_) {
+        for (uint8_t j = 0; j < mqtt_cmdfunctions_->size(); j++) {
+            if (match(j)) {
+                return j;
+            }
+        }
+    }
+    return -1;
+}
+
+void Command::index_cmd(uint8_t device_type, const __FlashStringHelper * cmd, uint8_t i) {
+    if (cmd_index_.insert(hash_cmd_P(device_type, cmd), i)) {
+        return;
+    }
+    if (!cmd_index_incomplete_) {
+        Serial.printf("command index is full at %u entries, find() will search all commands", cmd_index_.size());
+        Serial.println();
+        cmd_index_incomplete_ = true;
+    }
+}
+
+#if CONTAINER_NUM == 5
+bool Command::enable_cmd(uint8_t device_type, const char * cmd, bool on) {
+    int i = find_entry(device_type, cmd);
+    if (i < 0) {
+        return false;
+    }
+    mqtt_cmdfunctions_->enable(i, on);
+    return true;
+}
+#endif
+
 void Command::show_device_values() {
     uint8_t total_s = 0;
     uint8_t count   = 0;
@@ -117,5 +160,13 @@ void Command::show_device_values() {
     Serial.println(ss);
 }
 
+#if defined EMSESP_CONTAINER_STATS
+// what the container did on the heap since it was created
+void Command::show_stats() {
+    Serial.print("container stats: ");
+    mqtt_cmdfunctions_->stats().printTo(Serial);
+    Serial.println();
+}
+#endif
 
 } // namespace emsesp
@@ -3,13 +3,35 @@
 
 // 2 - uses std::function
 // 3 - uses C void * function pointer
+// 4 - uses emsesp::callback, lambdas without the heap
+// 5 - uses emsesp::delegate, object pointer and method
+// 6 - uses emsesp::handler_id, 1 byte index into a table of C function pointers in flash
 #define STRUCT_NUM 2
 
 #define NUM_ENTRIES 200
 
+// 1 - emsesp::array, on the heap and grows as needed
+// 2 - emsesp::static_array, NUM_ENTRIES fixed and no heap
+// 3 - emsesp::segmented_array, on the heap in chunks of 16, never moves
+// 4 - emsesp::static_array of NUM_ENTRIES in the startup arena, no heap header
+// 5 - emsesp::flash_table, a PROGMEM table built by the compiler, nothing registered at boot
+#define CONTAINER_NUM 1
+
 #include <Arduino.h>
 
+// allocation tracing only exists in the standalone build
+#ifndef HEAP_TRACE_SCOPE
+#define HEAP_TRACE_SCOPE(name)
+#endif
+
 #include "containers.h"
+#include "layout.h"
+#include "arena.h"
+#include "callback.h"
+#include "delegate.h"
+#include "handlers.h"
+#include "flash_table.h"
+#include "hash_index.h"
 
 #include <vector> // for flash_vectors
 using flash_string_vector = std::vector<const __FlashStringHelper *>;
@@ -20,12 +42,86 @@ using flash_string_vector = std::vector<const __FlashStringHelper *>;
 #include <deque>
 #include <string>
 
-#if STRUCT_NUM == 2
 #include <functional>
-#endif
+
+namespace uuid {
+std::string read_flash_string(const __FlashStringHelper * flash_str);
+} // namespace uuid
 
 namespace emsesp {
 
+// the callback styles under test
+using mqtt_cmd_std_function = std::function<void(const char * data, const int8_t id)>;
+using mqtt_cmd_c_function   = void (*)(const char *, const int8_t);
+using mqtt_cmd_callback     = emsesp::callback<void(const char * data, const int8_t id)>;
+using mqtt_cmd_delegate     = emsesp::delegate<void(const char * data, const int8_t id)>;
+
+// the functions a mqtt_cmd_handler can call, begin() it with a PROGMEM table in setup()
+struct mqtt_cmd_handlers {
+    static emsesp::handler_table<void(const char *, const int8_t)> & table() {
+        static emsesp::handler_table<void(const char *, const int8_t)> t;
+        return t;
+    }
+};
+
+using mqtt_cmd_handler = emsesp::handler_id<void(const char * data, const int8_t id), mqtt_cmd_handlers>;
+
+// a registered command, F is the callback type
+// "make layout32" prints its size and padding as on the ESP8266 (see bench/layout.cpp)
+// pointers first and the single bytes last, so a 1 byte handler_id packs with them
+template <typename F>
+struct MQTTCmdFunctionT {
+    const __FlashStringHelper *         dummy2_;           // 4
+    const __FlashStringHelper * const * options_;          // 4
+    const __FlashStringHelper *         cmd_;              // 4
+    F                                   mqtt_cmdfunction_; // 16 for std::function, 4 for a C function pointer, 1 for a handler_id
+    uint8_t                             device_type_;      // 1
+    uint8_t                             dummy1_;           // 1
+    uint8_t                             options_size_;     // 1
+
+    MQTTCmdFunctionT() = default;
+
+    MQTTCmdFunctionT(uint8_t                             device_type,
+                     uint8_t                             dummy1,
+                     const __FlashStringHelper *         dummy2,
+                     const __FlashStringHelper * const * options,
+                     uint8_t                             options_size,
+                     const __FlashStringHelper *         cmd,
+                     F &&                                f)
+        : dummy2_(dummy2)
+        , options_(options)
+        , cmd_(cmd)
+        , mqtt_cmdfunction_(std::move(f))
+        , device_type_(device_type)
+        , dummy1_(dummy1)
+        , options_size_(options_size) {
+    }
+};
+
+// a command known at compile time, the same fields as MQTTCmdFunctionT with a C function pointer
+// it is a plain aggregate so the compiler can put a table of them in flash, see MQTT_CMD_P
+struct MQTTCmdFunction_P {
+    const __FlashStringHelper *         dummy2_;
+    const __FlashStringHelper * const * options_;
+    const __FlashStringHelper *         cmd_;
+    mqtt_cmd_c_function                 mqtt_cmdfunction_;
+    uint8_t                             device_type_;
+    uint8_t                             dummy1_;
+    uint8_t                             options_size_;
+};
+
+// one entry of a PROGMEM command table, same arguments as register_mqtt_cmd()
+// strings must be F_() and options FL_() or nullptr, F() doesn't work outside a function
+#define MQTT_CMD_P(device_type, dummy1, dummy2, options, cmd, f)                                                                                               \
+    { dummy2, options, cmd, f, device_type, dummy1, emsesp::flash_list_size(options) }
+
+// bytes per element on the ESP8266 and on a 64 bit host, we store 200 of them
+EMSESP_SIZE_BUDGET(MQTTCmdFunctionT<mqtt_cmd_std_function>, 32, 64);
+EMSESP_SIZE_BUDGET(MQTTCmdFunctionT<mqtt_cmd_c_function>, 20, 40);
+EMSESP_SIZE_BUDGET(MQTTCmdFunctionT<mqtt_cmd_callback>, 28, 56);
+EMSESP_SIZE_BUDGET(MQTTCmdFunctionT<mqtt_cmd_delegate>, 24, 48);
+EMSESP_SIZE_BUDGET(MQTTCmdFunctionT<mqtt_cmd_handler>, 16, 32);
+
 class Command {
   public:
     ~Command() = default;
@@ -36,33 +132,35 @@ class Command {
 #if STRUCT_NUM == 2
     // no constructor, with std::function
     // size on ESP8266 - 28 bytes (ubuntu 56, osx 80)
-    using mqtt_cmdfunction_p = std::function<void(const char * data, const int8_t id)>;
-    struct MQTTCmdFunction {
-        uint8_t                             device_type_;      // 1 byte
-        uint8_t                             dummy1_;           // 1 byte
-        const __FlashStringHelper *         dummy2_;           // 4
-        const __FlashStringHelper * const * options_;          // ?
-        uint8_t                             options_size_;     // 1
-        const __FlashStringHelper *         cmd_;              // 4
-        mqtt_cmdfunction_p                  mqtt_cmdfunction_; // 14
-    };
+    using mqtt_cmdfunction_p = mqtt_cmd_std_function;
 #endif
 
 #if STRUCT_NUM == 3
     // no constructor, using C style function pointers instead of std::function
     // size on ESP8266 - 16 bytes (ubuntu 32, osx 32)
-    using mqtt_cmdfunction_p = void (*)(const char *, const int8_t);
-    struct MQTTCmdFunction {
-        uint8_t                             device_type_;      // 1 byte
-        uint8_t                             dummy1_;           // 1 byte
-        const __FlashStringHelper *         dummy2_;           // 4
-        const __FlashStringHelper * const * options_;          // ?
-        uint8_t                             options_size_;     // 1
-        const __FlashStringHelper *         cmd_;              // 4
-        mqtt_cmdfunction_p                  mqtt_cmdfunction_; // 6
-    };
+    using mqtt_cmdfunction_p = mqtt_cmd_c_function;
+#endif
+
+#if STRUCT_NUM == 4
+    // emsesp::callback, a lambda capturing up to 2 pointers is kept inline
+    // size on ESP8266 - 12 bytes (ubuntu 24)
+    using mqtt_cmdfunction_p = mqtt_cmd_callback;
+#endif
+
+#if STRUCT_NUM == 5
+    // emsesp::delegate, calls a method on a device object
+    // size on ESP8266 - 8 bytes (ubuntu 16)
+    using mqtt_cmdfunction_p = mqtt_cmd_delegate;
+#endif
+
+#if STRUCT_NUM == 6
+    // emsesp::handler_id, the index of the function in mqtt_cmd_handlers::table()
+    // size on ESP8266 - 1 byte
+    using mqtt_cmdfunction_p = mqtt_cmd_handler;
 #endif
 
+    using MQTTCmdFunction = MQTTCmdFunctionT<mqtt_cmdfunction_p>;
+
     void register_mqtt_cmd(uint8_t                             device_type,
                            uint8_t                             dummy1,
                            const __FlashStringHelper *         dummy2,
@@ -72,18 +170,107 @@ class Command {
 
     void print(uint32_t mem_used);
 
+    // index of the command cmd of device_type, -1 if there is none or it is disabled
+    // a hash lookup, it takes the same time for 10 or 200 commands
+    int find(uint8_t device_type, const char * cmd) const;
+
     void show_device_values();
 
+#if CONTAINER_NUM == 5
+    // the commands are a table in PROGMEM, call after reserve() instead of register_mqtt_cmd()
+    template <size_t N>
+    void register_mqtt_cmds_P(const MQTTCmdFunction_P (&table)[N]) {
+        mqtt_cmdfunctions_->begin(table);
+        cmd_index_.reserve(mqtt_cmdfunctions_->size());
+        for (uint8_t i = 0; i < mqtt_cmdfunctions_->size(); i++) {
+            const auto & mf = (*mqtt_cmdfunctions_)[i];
+            index_cmd(mf.device_type_, mf.cmd_, i);
+        }
+    }
+
+    // turns a command off or on at runtime, find() skips it while it is off
+    // only the bit in the RAM overlay changes, the table in flash stays as it is
+    // false if there is no such command
+    bool enable_cmd(uint8_t device_type, const char * cmd, bool on);
+#endif
+
+    // call once all commands are registered, gives back the unused entries
+    void freeze() {
+        mqtt_cmdfunctions_->freeze();
+    }
+
+    // for everything registered in setup() that is kept until reboot
+    // begin() it at the start of setup() and seal() it when registration is done
+    static emsesp::arena & startup_arena() {
+        static emsesp::arena a;
+        return a;
+    }
+
+#if defined EMSESP_CONTAINER_STATS
+    void show_stats();
+#endif
+
     // note assignment must be static
     void reserve(uint8_t elements, uint8_t max, uint8_t grow) {
         // static auto a = std::vector<MQTTCmdFunction>();                      // std::vector
         // static auto a = std::queue<MQTTCmdFunction>(elements);               // std::queue
         // static auto mqtt_cmdfunctions_ = emsesp::queue<MQTTCmdFunction>(elements); // emsesp::queue
 
+#if CONTAINER_NUM == 1
         static auto a      = emsesp::array<MQTTCmdFunction>(elements, max, grow); // emsesp::array
         mqtt_cmdfunctions_ = &a;                                                  // emsesp::array
+#endif
+
+#if CONTAINER_NUM == 2
+        // fixed at NUM_ENTRIES, the sizes are ignored
+        (void)elements;
+        (void)max;
+        (void)grow;
+        static emsesp::static_array<MQTTCmdFunction, NUM_ENTRIES> a; // emsesp::static_array
+        mqtt_cmdfunctions_ = &a;
+#endif
+
+#if CONTAINER_NUM == 4
+        // packed into the startup arena, on the heap if that wasn't started or is full
+        (void)elements;
+        (void)max;
+        (void)grow;
+        using table = emsesp::static_array<MQTTCmdFunction, NUM_ENTRIES>;
+        mqtt_cmdfunctions_ = startup_arena().create<table>();
+        if (mqtt_cmdfunctions_ == nullptr) {
+            mqtt_cmdfunctions_ = new table();
+        }
+#endif
+
+#if CONTAINER_NUM == 3
+        // grows a chunk at a time, the sizes are ignored
+        (void)elements;
+        (void)max;
+        (void)grow;
+        static emsesp::segmented_array<MQTTCmdFunction, 16> a; // emsesp::segmented_array
+        mqtt_cmdfunctions_ = &a;
+#endif
+
+#if CONTAINER_NUM == 5
+        // only the enabled bits are in RAM, the table comes with register_mqtt_cmds_P()
+        (void)elements;
+        (void)max;
+        (void)grow;
+        static emsesp::flash_table<MQTTCmdFunction_P, NUM_ENTRIES> a; // emsesp::flash_table
+        mqtt_cmdfunctions_ = &a;
+#endif
 
         // mqtt_cmdfunctions_ = a; // std::queue
+
+        // the name index fits the most commands the container can hold
+        // the flash table sizes it in register_mqtt_cmds_P(), once the table is known
+#if CONTAINER_NUM == 1
+        cmd_index_.reserve(max);
+#elif CONTAINER_NUM == 2 || CONTAINER_NUM == 4
+        cmd_index_.reserve(NUM_ENTRIES);
+#elif CONTAINER_NUM == 3
+        cmd_index_.reserve(ARRAY_MAX_SIZE);
+#endif
     }
 
     //  emsesp::array<MQTTCmdFunction> mqtt_cmdfunctions()  {
@@ -102,8 +289,51 @@ class Command {
   private:
     uint8_t style_ = STRUCT_NUM;
 
+    int find_entry(uint8_t device_type, const char * cmd) const;
+
+    // adds command i to cmd_index_, if that is full or wasn't reserved find() falls back to a linear search
+    void index_cmd(uint8_t device_type, const __FlashStringHelper * cmd, uint8_t i);
+
+#if CONTAINER_NUM == 5
+    bool cmd_enabled(uint8_t i) const {
+        return mqtt_cmdfunctions_->enabled(i);
+    }
+#else
+    // only the flash table can turn commands off
+    bool cmd_enabled(uint8_t i __attribute__((unused))) const {
+        return true;
+    }
+#endif
+
+    // cmd_ and device_type_ of every registered command, 2 bytes per slot
+    // taken from the startup arena when it has room, from the heap otherwise
+    emsesp::hash_index<emsesp::arena_heap_allocator> cmd_index_{emsesp::arena_heap_allocator(startup_arena())};
+    bool                                             cmd_index_incomplete_ = false;
+
+#if CONTAINER_NUM == 1
     // 3: 200,255,16  5640, 28 bytes per element
     emsesp::array<MQTTCmdFunction> * mqtt_cmdfunctions_;
+#endif
+
+#if CONTAINER_NUM == 2
+    // no heap, sizeof(MQTTCmdFunction) * NUM_ENTRIES in .bss
+    emsesp::static_array<MQTTCmdFunction, NUM_ENTRIES> * mqtt_cmdfunctions_;
+#endif
+
+#if CONTAINER_NUM == 3
+    // 13 chunks of 16 for 200 entries, plus the directory inside the object
+    emsesp::segmented_array<MQTTCmdFunction, 16> * mqtt_cmdfunctions_;
+#endif
+
+#if CONTAINER_NUM == 4
+    // sizeof(MQTTCmdFunction) * NUM_ENTRIES in the startup arena
+    emsesp::static_array<MQTTCmdFunction, NUM_ENTRIES> * mqtt_cmdfunctions_;
+#endif
+
+#if CONTAINER_NUM == 5
+    // the table is in flash, 25 bytes of enabled bits in .bss
+    emsesp::flash_table<MQTTCmdFunction_P, NUM_ENTRIES> * mqtt_cmdfunctions_;
+#endif
 
     // 3: empty, 7208, 36 bytes per element
     // std::vector<MQTTCmdFunction> mqtt_cmdfunctions_;
@@ -19,7 +19,10 @@
 /*
  * Lightweight queue & array
  * Based ideas from https://github.com/muwerk/ustd
- * Limits to max 255 entries
+ * Limits to max 255 entries, unless the size type S is set to uint16_t
+ * static_array keeps its entries inside the object and never touches the heap
+ * segmented_array grows in chunks and never moves its entries
+ * queue and array take their buffer from an allocator A, by default straight from the heap
  */
 
 #ifndef EMSESP_CONTAINERS_H
@@ -27,25 +30,95 @@
 
 #include <Arduino.h>
 
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+
 #if defined EMSESP_ASSERT
 #include <assert.h>
 #endif
 
+// build with -DEMSESP_CONTAINER_STATS to count what the containers do on the heap
+#if defined EMSESP_CONTAINER_STATS
+#define EMSESP_STATS(statement) statement
+#else
+#define EMSESP_STATS(statement)
+#endif
+
 namespace emsesp {
 
+// true if T can be moved around with memcpy() or realloc()
+// std::is_trivially_copyable is missing in gcc 4.8 which the ESP8266 core 2.7 still uses
 template <typename T>
+struct is_trivially_relocatable
+#if __GNUC__ >= 5 || defined(__clang__)
+    : std::integral_constant<bool, std::is_trivially_copyable<T>::value> {
+#else
+    : std::integral_constant<bool, __has_trivial_copy(T) && __has_trivial_destructor(T)> {
+#endif
+};
+
+// default allocator of queue and array, plain malloc/free on the umm_malloc heap
+// any class with these three functions can be used instead, e.g. arena_allocator.
+// it is a base class of the containers, so an allocator without state takes no room
+struct heap_allocator {
+    void * allocate(size_t size) {
+        return malloc(size);
+    }
+
+    void deallocate(void * p, size_t size __attribute__((unused))) {
+        free(p);
+    }
+
+    // resize a block keeping its contents, nullptr (and p untouched) if it failed
+    void * reallocate(void * p, size_t size __attribute__((unused)), size_t new_size) {
+        return realloc(p, new_size);
+    }
+};
+
+#if defined EMSESP_CONTAINER_STATS
+// counters kept by queue and array, see stats()
+struct container_stats {
+    uint32_t pushes_       = 0;
+    uint32_t pops_         = 0;
+    uint32_t rejected_     = 0; // pushes that failed, container full or out of memory
+    uint32_t resizes_      = 0; // reallocations of the buffer
+    uint32_t bytes_copied_ = 0; // by those reallocations
+    uint16_t peak_alloc_   = 0; // largest number of allocated entries
+
+    size_t printTo(Print & p) const {
+        char s[120];
+        snprintf_P(s,
+                   sizeof(s),
+                   PSTR("pushes=%u pops=%u rejected=%u resizes=%u copied=%u bytes peak alloc=%u"),
+                   pushes_,
+                   pops_,
+                   rejected_,
+                   resizes_,
+                   bytes_copied_,
+                   peak_alloc_);
+        return p.print(s);
+    }
+};
+#endif
+
+// walks the queue from front to back, wrapping around the end of the buffer
+template <typename T, typename S = uint8_t>
 class queueIterator {
   public:
-    queueIterator(T * values_ptr, uint8_t p)
+    queueIterator(T * values_ptr, S front, S maxSize, S p)
         : values_ptr_{values_ptr}
+        , front_{front}
+        , maxSize_{maxSize}
         , position_{p} {
     }
 
-    bool operator!=(const queueIterator<T> & other) const {
+    bool operator!=(const queueIterator<T, S> & other) const {
         return !(*this == other);
     }
 
-    bool operator==(const queueIterator<T> & other) const {
+    bool operator==(const queueIterator<T, S> & other) const {
         return position_ == other.position_;
     }
 
@@ -55,114 +128,191 @@ class queueIterator {
     }
 
     T & operator*() const {
-        return *(values_ptr_ + position_);
+        uint32_t i = front_ + position_;
+        return *(values_ptr_ + ((i >= maxSize_) ? i - maxSize_ : i));
     }
 
   private:
     T *     values_ptr_;
-    uint8_t position_;
+    S front_;
+    S maxSize_;
+    S position_; // 0 is the front
 };
 
-template <class T>
-class queue {
+// ring buffer with a fixed number of entries
+// push and pop at both ends are O(1), nothing is ever moved
+// S is the type of all sizes and indexes, uint16_t allows for more than 255 entries
+// A is the allocator of the buffer, see heap_allocator
+template <class T, typename S = uint8_t, class A = heap_allocator>
+class queue : private A {
   private:
-    T *     que_;
-    uint8_t peakSize_;
-    uint8_t maxSize_;
-    uint8_t size_;
-    uint8_t quePtrFront_; // back
-    uint8_t quePtrBack_;  // front
-    T       bad_;
+    T * que_;
+    S   peakSize_;
+    S   maxSize_;
+    S   size_;
+    S   quePtrFront_; // oldest entry
+    S   quePtrBack_;  // where the next push() goes
+    T   bad_;
+#if defined EMSESP_CONTAINER_STATS
+    container_stats stats_;
+#endif
+
+    // next and previous slot in the ring
+    S next(S i) const {
+        return (i + 1 >= maxSize_) ? 0 : i + 1;
+    }
+    S prev(S i) const {
+        return (i == 0) ? maxSize_ - 1 : i - 1;
+    }
+
+    // slot of the i-th entry counted from the front
+    S slot(S i) const {
+        uint32_t s = quePtrFront_ + i;
+        return (s >= maxSize_) ? s - maxSize_ : s;
+    }
+
+    A & allocator() {
+        return *this;
+    }
+
+    void pushed() {
+        ++size_;
+        if (size_ > peakSize_) {
+            peakSize_ = size_;
+        }
+        EMSESP_STATS(stats_.pushes_++);
+    }
 
   public:
     // Constructs a queue object with the maximum number of <T> pointer entries
-    queue(uint8_t maxQueueSize)
-        : maxSize_(maxQueueSize) {
+    queue(S maxQueueSize, const A & alloc = A())
+        : A(alloc)
+        , maxSize_(maxQueueSize) {
         memset(&bad_, 0, sizeof(bad_));
         quePtrFront_ = 0;
         quePtrBack_  = 0;
         size_        = 0;
         peakSize_    = 0;
-        que_         = (T *)malloc(sizeof(T) * maxSize_);
+        que_         = (T *)allocator().allocate(sizeof(T) * maxSize_);
         if (que_ == nullptr)
             maxSize_ = 0;
+        EMSESP_STATS(stats_.peak_alloc_ = maxSize_);
     }
 
     // Deallocate the queue structure
     ~queue() {
         if (que_ != nullptr) {
-            free(que_);
+            while (size_) {
+                que_[quePtrFront_].~T();
+                quePtrFront_ = next(quePtrFront_);
+                --size_;
+            }
+            allocator().deallocate(que_, sizeof(T) * maxSize_);
             que_ = nullptr;
         }
     }
 
-    // Push a new entry into the queue.
-    // true on success, false if queue is full, then the element is relaced with the front one
-    bool push(T ent) {
-        // Serial.print("quePtrFront_: ");
-        // Serial.print(quePtrFront_);
-        // Serial.print(" quePtrBack_: ");
-        // Serial.print(quePtrBack_);
-        // Serial.println();
+    // Construct a new entry in place at the back of the queue, args are passed to the constructor of T
+    // true on success, false if queue is full
+    template <class... Args>
+    bool emplace(Args &&... args) {
         if (size_ >= maxSize_) {
-            // que_[quePtrFront_] = ent;
+            EMSESP_STATS(stats_.rejected_++);
             return false;
         }
-        que_[quePtrBack_] = ent;
-        quePtrBack_       = (quePtrBack_ + 1) % maxSize_;
-        ++size_;
-        if (size_ > peakSize_) {
-            peakSize_ = size_;
-        }
+        new (&que_[quePtrBack_]) T(std::forward<Args>(args)...);
+        quePtrBack_ = next(quePtrBack_);
+        pushed();
         return true;
     }
 
-    bool push_back(T ent) {
-        return push(ent);
-    }
-
-    // Push a new entry into the front of queue, moving the rest down
+    // Construct a new entry in place at the front of the queue, so it's the next one to be popped
     // true on success, false if queue is full
-    // there are no good checks for overflow
-    bool push_front(T ent) {
+    template <class... Args>
+    bool emplace_front(Args &&... args) {
         if (size_ >= maxSize_) {
+            EMSESP_STATS(stats_.rejected_++);
             return false;
         }
-        // Serial.print("quePtrFront_: ");
-        // Serial.print(quePtrFront_);
-        // Serial.print(" quePtrBack_: ");
-        // Serial.print(quePtrBack_);
-        // Serial.println();
-
-        for (uint8_t i = 0; i <= size_; i++) {
-            que_[quePtrBack_ - i + 1] = que_[quePtrBack_ - i]; // move the rest up 1
-        }
-        que_[quePtrFront_] = ent; // add the new one
-        quePtrBack_        = (quePtrBack_ + 1) % maxSize_;
-        ++size_;
-        if (size_ > peakSize_) {
-            peakSize_ = size_;
-        }
+        quePtrFront_ = prev(quePtrFront_);
+        new (&que_[quePtrFront_]) T(std::forward<Args>(args)...);
+        pushed();
         return true;
     }
 
-    T & operator[](uint8_t i) {
-        return que_[i + quePtrFront_];
+    // Push a new entry to the back of the queue
+    // true on success, false if queue is full
+    bool push(const T & ent) {
+        return emplace(ent);
+    }
+
+    bool push(T && ent) {
+        return emplace(std::move(ent));
+    }
+
+    bool push_back(const T & ent) {
+        return emplace(ent);
+    }
+
+    bool push_back(T && ent) {
+        return emplace(std::move(ent));
+    }
+
+    // Push a new entry to the front of the queue, so it's the next one to be popped
+    // true on success, false if queue is full
+    bool push_front(const T & ent) {
+        return emplace_front(ent);
+    }
+
+    bool push_front(T && ent) {
+        return emplace_front(std::move(ent));
+    }
+
+    // i-th entry counted from the front, no bounds check
+    T & operator[](S i) {
+        return que_[slot(i)];
+    }
+
+    const T & operator[](S i) const {
+        return que_[slot(i)];
+    }
+
+    // the entries at both ends, bad_ if the queue is empty
+    T & front() {
+        return (size_ == 0) ? bad_ : que_[quePtrFront_];
+    }
+
+    T & back() {
+        return (size_ == 0) ? bad_ : que_[prev(quePtrBack_)];
     }
 
     // Pop the oldest entry from the queue
     T pop() {
         if (size_ == 0)
             return bad_;
-        T ent        = que_[quePtrFront_];
-        quePtrFront_ = (quePtrFront_ + 1) % maxSize_;
+        T ent(std::move(que_[quePtrFront_]));
+        que_[quePtrFront_].~T();
+        quePtrFront_ = next(quePtrFront_);
         --size_;
+        EMSESP_STATS(stats_.pops_++);
         return ent;
     }
 
     // alias pop_front to keep backwards compatibility with std::list/queue
     T pop_front() {
-        pop();
+        return pop();
+    }
+
+    // Pop the newest entry from the queue
+    T pop_back() {
+        if (size_ == 0)
+            return bad_;
+        quePtrBack_ = prev(quePtrBack_);
+        --size_;
+        EMSESP_STATS(stats_.pops_++);
+        T ent(std::move(que_[quePtrBack_]));
+        que_[quePtrBack_].~T();
+        return ent;
     }
 
     // Set the value for <T>entry that's given back, if read from an empty
@@ -173,7 +323,7 @@ class queue {
     }
 
     // returns true: queue empty, false: not empty
-    bool empty() {
+    bool empty() const {
         if (size_ == 0)
             return true;
         else
@@ -181,34 +331,40 @@ class queue {
     }
 
     // returns number of entries in the queue
-    uint8_t size() {
+    S size() const {
         return (size_);
     }
 
     // max number of queue entries that have been in the queue
-    uint8_t peak() {
+    S peak() const {
         return (peakSize_);
     }
 
+#if defined EMSESP_CONTAINER_STATS
+    const container_stats & stats() const {
+        return stats_;
+    }
+#endif
+
     // iterators
-    queueIterator<T> begin() {
-        return queueIterator<T>(que_, quePtrFront_);
+    queueIterator<T, S> begin() {
+        return queueIterator<T, S>(que_, quePtrFront_, maxSize_, 0);
     }
-    queueIterator<T> end() {
-        return queueIterator<T>(que_, quePtrFront_ + size_);
+    queueIterator<T, S> end() {
+        return queueIterator<T, S>(que_, quePtrFront_, maxSize_, size_);
     }
 
-    queueIterator<const T> begin() const {
-        return queueIterator<const T>(que_, quePtrFront_);
+    queueIterator<const T, S> begin() const {
+        return queueIterator<const T, S>(que_, quePtrFront_, maxSize_, 0);
     }
 
-    queueIterator<const T> end() const {
-        return queueIterator<const T>(que_, quePtrFront_ + size_);
+    queueIterator<const T, S> end() const {
+        return queueIterator<const T, S>(que_, quePtrFront_, maxSize_, size_);
     }
 };
 
 
-template <typename T>
+template <typename T, typename S = uint8_t>
 class arrayIterator {
   public:
     arrayIterator(T * values_ptr)
@@ -216,16 +372,16 @@ class arrayIterator {
         , position_{0} {
     }
 
-    arrayIterator(T * values_ptr, size_t size_)
+    arrayIterator(T * values_ptr, S size_)
         : values_ptr_{values_ptr}
         , position_{size_} {
     }
 
-    bool operator!=(const arrayIterator<T> & other) const {
+    bool operator!=(const arrayIterator<T, S> & other) const {
         return !(*this == other);
     }
 
-    bool operator==(const arrayIterator<T> & other) const {
+    bool operator==(const arrayIterator<T, S> & other) const {
         return position_ == other.position_;
     }
 
@@ -239,24 +395,53 @@ class arrayIterator {
     }
 
   private:
-    T *    values_ptr_;
-    size_t position_;
+    T * values_ptr_;
+    S   position_;
 };
 
 #define ARRAY_INIT_SIZE 16
-#define ARRAY_MAX_SIZE 255 // fixed for uint8_t
+#define ARRAY_MAX_SIZE 255 // limit with the default uint8_t size type
 #define ARRAY_INC_SIZE 16
 
-template <typename T>
-class array {
+// array on the heap that grows by incSize_ entries when full
+// S is the type of all sizes and indexes, uint16_t allows for more than 255 entries
+// A is the allocator of the buffer, see heap_allocator
+template <typename T, typename S = uint8_t, class A = heap_allocator>
+class array : private A {
   private:
-    T *     arr_;
-    uint8_t startSize_;
-    uint8_t maxSize_;
-    uint8_t incSize_ = ARRAY_INC_SIZE;
-    uint8_t allocSize_;
-    uint8_t size_;
-    T       bad_;
+    T * arr_;
+    S   startSize_;
+    S   maxSize_;
+    S   incSize_ = ARRAY_INC_SIZE;
+    S   allocSize_;
+    S   size_;
+    T   bad_;
+#if defined EMSESP_CONTAINER_STATS
+    container_stats stats_;
+#endif
+
+    A & allocator() {
+        return *this;
+    }
+
+    // entries that can be copied with memcpy go through realloc(), which grows the block
+    // in place when the heap after it is free and never needs the old and new block at once
+    T * reallocate(uint32_t newSize, std::true_type) {
+        return (T *)allocator().reallocate(arr_, sizeof(T) * allocSize_, sizeof(T) * newSize);
+    }
+
+    // everything else is moved into a new block, for std::function that is a few pointers instead of a copy
+    T * reallocate(uint32_t newSize, std::false_type) {
+        T * arrn = (T *)allocator().allocate(sizeof(T) * newSize);
+        if (arrn == nullptr)
+            return nullptr;
+        for (S i = 0; i < size_; i++) {
+            new (&arrn[i]) T(std::move(arr_[i]));
+            arr_[i].~T();
+        }
+        allocator().deallocate(arr_, sizeof(T) * allocSize_);
+        return arrn;
+    }
 
   public:
     // Constructs an array object. All allocation-hints are optional, the
@@ -269,8 +454,10 @@ class array {
     // needed.
     // @param incSize_ The number of array entries that are allocated as a
     // chunk if the array needs to grow
-    array(uint8_t startSize_ = ARRAY_INIT_SIZE, uint8_t maxSize_ = ARRAY_MAX_SIZE, uint8_t incSize_ = ARRAY_INC_SIZE)
-        : startSize_(startSize_)
+    // @param alloc The allocator the entries are taken from
+    array(S startSize_ = ARRAY_INIT_SIZE, S maxSize_ = std::numeric_limits<S>::max(), S incSize_ = ARRAY_INC_SIZE, const A & alloc = A())
+        : A(alloc)
+        , startSize_(startSize_)
         , maxSize_(maxSize_)
         , incSize_(incSize_) {
         size_ = 0;
@@ -278,20 +465,25 @@ class array {
         if (maxSize_ < startSize_)
             maxSize_ = startSize_;
         allocSize_ = startSize_;
-        arr_       = new T[allocSize_];
+        arr_       = (T *)allocator().allocate(sizeof(T) * allocSize_); // entries are only constructed when added
+        if (arr_ == nullptr)
+            allocSize_ = 0;
+        EMSESP_STATS(stats_.peak_alloc_ = allocSize_);
     }
 
     ~array() {
         /*! Free resources */
         if (arr_ != nullptr) {
-            delete[] arr_;
+            for (S i = 0; i < size_; i++) {
+                arr_[i].~T();
+            }
+            allocator().deallocate(arr_, sizeof(T) * allocSize_);
             arr_ = nullptr;
         }
     }
 
     // Change the array allocation size_. the new number of array entries, corresponding memory is allocated/free'd as necessary.
-    bool resize(uint8_t newSize) {
-        uint8_t mv = newSize;
+    bool resize(uint32_t newSize) {
         if (newSize > maxSize_) {
             if (maxSize_ == allocSize_)
                 return false;
@@ -300,18 +492,51 @@ class array {
         }
         if (newSize <= allocSize_)
             return true;
-        T * arrn = new T[newSize];
+        T * arrn = reallocate(newSize, is_trivially_relocatable<T>());
         if (arrn == nullptr)
             return false;
-        for (uint8_t i = 0; i < mv; i++) {
-            arrn[i] = arr_[i];
-        }
-        delete[] arr_;
+        EMSESP_STATS(stats_.resizes_++);
+        EMSESP_STATS(stats_.bytes_copied_ += (arrn != arr_) ? size_ * sizeof(T) : 0);
         arr_       = arrn;
         allocSize_ = newSize;
+#if defined EMSESP_CONTAINER_STATS
+        if (allocSize_ > stats_.peak_alloc_) {
+            stats_.peak_alloc_ = allocSize_;
+        }
+#endif
+        return true;
+    }
+
+    // Give back the allocated entries beyond size(). The trimmed block is allocated
+    // before the old one is freed (or shrunk in place by realloc() for trivially copyable entries)
+    // returns false if there was no memory for the smaller block, the array is then unchanged
+    bool shrink_to_fit() {
+        if (size_ == allocSize_)
+            return true;
+        if (size_ == 0) {
+            allocator().deallocate(arr_, sizeof(T) * allocSize_);
+            arr_       = nullptr;
+            allocSize_ = 0;
+            return true;
+        }
+        T * arrn = reallocate(size_, is_trivially_relocatable<T>());
+        if (arrn == nullptr)
+            return false;
+        EMSESP_STATS(stats_.resizes_++);
+        EMSESP_STATS(stats_.bytes_copied_ += (arrn != arr_) ? size_ * sizeof(T) : 0);
+        arr_       = arrn;
+        allocSize_ = size_;
         return true;
     }
 
+    // Call when all entries have been added, e.g. at the end of setup(). Trims the
+    // array to its size and stops it from growing, push() and emplace() fail from now on
+    void freeze() {
+        shrink_to_fit();
+        maxSize_ = size_;
+        incSize_ = 0;
+    }
+
     // Set the value for <T>entry that's given back,
     // if read of an invalid index is requested.
     // By default, an entry all memset to zero is given
@@ -321,47 +546,53 @@ class array {
         bad_ = entryInvalidValue;
     }
 
-    // Append an array element after the current end of the array
-    // takes entry array element that is appended after the last current
-    // entry. The new array size_ must be smaller than maxSize_ as defined
-    // during array creation. New array memory is automatically allocated if
-    // within maxSize_ boundaries
-    int push(T & entry) {
+    // Construct an array element in place after the current end of the array,
+    // args are passed to the constructor of T. The new array size_ must be smaller
+    // than maxSize_ as defined during array creation. New array memory is
+    // automatically allocated if within maxSize_ boundaries
+    // returns the index of the new element or -1 if there is no room
+    template <class... Args>
+    int emplace(Args &&... args) {
+        if (size_ >= maxSize_) {
+            EMSESP_STATS(stats_.rejected_++);
+            return -1;
+        }
         if (size_ >= allocSize_) {
-            if (incSize_ == 0)
-                return -1;
-            if (!resize(allocSize_ + incSize_))
+            if ((incSize_ == 0) || !resize(allocSize_ + incSize_)) {
+                EMSESP_STATS(stats_.rejected_++);
                 return -1;
+            }
         }
-        arr_[size_] = entry;
+        new (&arr_[size_]) T(std::forward<Args>(args)...);
         ++size_;
+        EMSESP_STATS(stats_.pushes_++);
         return size_ - 1;
     }
 
-    // Assign content of array element at i for const's
-    T operator[](uint8_t i) const {
-        if (i >= allocSize_) {
-            if (incSize_ == 0) {
-#ifdef EMSESP_ASSERT
-                assert(i < allocSize_);
-#endif
-            }
-            if (!resize(allocSize_ + incSize_)) {
+    // Append a copy of entry after the current end of the array
+    int push(const T & entry) {
+        return emplace(entry);
+    }
+
+    // Append entry after the current end of the array, moving it in
+    int push(T && entry) {
+        return emplace(std::move(entry));
+    }
+
+    // Read an array element, bad_ if i is out of range
+    const T & operator[](S i) const {
 #ifdef EMSESP_ASSERT
-                assert(i < allocSize_);
+        assert(i < size_);
 #endif
-            }
-        }
-        if (i >= size_ && i <= allocSize_)
-            size_ = i + 1;
-        if (i >= allocSize_) {
+        if (i >= size_) {
             return bad_;
         }
         return arr_[i];
     }
 
-    // Assign content of array element at i
-    T & operator[](uint8_t i) {
+    // Assign content of array element at i, the array is extended (and grown if needed)
+    // up to i with default constructed elements
+    T & operator[](S i) {
         if (i >= allocSize_) {
             if (incSize_ == 0) {
 #ifdef EMSESP_ASSERT
@@ -374,11 +605,13 @@ class array {
 #endif
             }
         }
-        if (i >= size_ && i <= allocSize_)
-            size_ = i + 1;
         if (i >= allocSize_) {
             return bad_;
         }
+        while (size_ <= i) {
+            new (&arr_[size_]) T();
+            ++size_;
+        }
         return arr_[i];
     }
 
@@ -391,39 +624,331 @@ class array {
     }
 
     // return number of array elements
-    uint8_t size() const {
+    S size() const {
         return (size_);
     }
 
     // returns number of allocated entries which can be larger than the length of the array
-    uint8_t alloclen() const {
+    S alloclen() const {
         return (allocSize_);
     }
 
-    // emplace
-    // template <typename... Args>
-    // void emplace1(Args... args) {
-    //     add(args...);
-    // };
-    // template <class... Args>
-    // void emplace(Args &&... args) {
-    //     add(T(std::forward<Args>(args)...));
-    // }
+#if defined EMSESP_CONTAINER_STATS
+    const container_stats & stats() const {
+        return stats_;
+    }
+#endif
 
     // iterators
-    arrayIterator<T> begin() {
-        return arrayIterator<T>(arr_);
+    arrayIterator<T, S> begin() {
+        return arrayIterator<T, S>(arr_);
+    }
+    arrayIterator<T, S> end() {
+        return arrayIterator<T, S>(arr_, size_);
     }
-    arrayIterator<T> end() {
-        return arrayIterator<T>(arr_, size_);
+
+    arrayIterator<const T, S> begin() const {
+        return arrayIterator<const T, S>(arr_);
     }
 
-    arrayIterator<const T> begin() const {
-        return arrayIterator<const T>(arr_);
+    arrayIterator<const T, S> end() const {
+        return arrayIterator<const T, S>(arr_, size_);
     }
+};
+
+// fixed capacity array with the entries stored inside the object, for tables that never grow
+// make it static or global and it costs no heap and causes no fragmentation
+// same push/operator[]/iterator interface as array, but there is no bad_ entry to fall back on,
+// so indexes past size() are only checked with EMSESP_ASSERT
+template <typename T, size_t N>
+class static_array {
+  public:
+    // uint8_t is enough for up to 255 entries
+    using size_type = typename std::conditional<(N <= UINT8_MAX), uint8_t, uint16_t>::type;
 
-    arrayIterator<const T> end() const {
-        return arrayIterator<const T>(arr_, size_);
+    static_assert(N > 0 && N <= UINT16_MAX, "static_array holds 1 to 65535 entries");
+
+    static_array()
+        : size_(0) {
+        EMSESP_STATS(stats_.peak_alloc_ = N);
+    }
+
+    ~static_array() {
+        clear();
+    }
+
+    static_array(const static_array &) = delete;
+    static_array & operator=(const static_array &) = delete;
+
+    // constructs an entry in the next free slot, returns its index or -1 when full
+    template <class... Args>
+    int emplace(Args &&... args) {
+        if (size_ >= N) {
+            EMSESP_STATS(stats_.rejected_++);
+            return -1;
+        }
+        new (&data_[size_]) T(std::forward<Args>(args)...);
+        EMSESP_STATS(stats_.pushes_++);
+        return size_++;
+    }
+
+    int push(const T & entry) {
+        return emplace(entry);
+    }
+
+    int push(T && entry) {
+        return emplace(std::move(entry));
+    }
+
+    T & operator[](size_type i) {
+#ifdef EMSESP_ASSERT
+        assert(i < size_);
+#endif
+        return values()[i];
+    }
+
+    const T & operator[](size_type i) const {
+#ifdef EMSESP_ASSERT
+        assert(i < size_);
+#endif
+        return values()[i];
+    }
+
+    // destroys all entries
+    void clear() {
+        for (size_type i = 0; i < size_; i++) {
+            values()[i].~T();
+        }
+        size_ = 0;
+    }
+
+    bool empty() const {
+        return (size_ == 0);
+    }
+
+    size_type size() const {
+        return (size_);
+    }
+
+    // always N, nothing is allocated later
+    size_type alloclen() const {
+        return N;
+    }
+
+    // the storage is part of the object, there is nothing to give back
+    void shrink_to_fit() {
+    }
+    void freeze() {
+    }
+
+#if defined EMSESP_CONTAINER_STATS
+    const container_stats & stats() const {
+        return stats_;
+    }
+#endif
+
+    // iterators
+    arrayIterator<T, size_type> begin() {
+        return arrayIterator<T, size_type>(values());
+    }
+    arrayIterator<T, size_type> end() {
+        return arrayIterator<T, size_type>(values(), size_);
+    }
+
+    arrayIterator<const T, size_type> begin() const {
+        return arrayIterator<const T, size_type>(values());
+    }
+
+    arrayIterator<const T, size_type> end() const {
+        return arrayIterator<const T, size_type>(values(), size_);
+    }
+
+  private:
+    // raw storage, entries are only constructed when pushed
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type data_[N];
+    size_type                                                 size_;
+#if defined EMSESP_CONTAINER_STATS
+    container_stats stats_;
+#endif
+
+    T * values() {
+        return reinterpret_cast<T *>(data_);
+    }
+    const T * values() const {
+        return reinterpret_cast<const T *>(data_);
+    }
+};
+
+// walks a segmented_array, entry i is in chunk i / C
+template <typename T, size_t C>
+class segmentedIterator {
+  public:
+    segmentedIterator(T * const * chunks, uint8_t p)
+        : chunks_{chunks}
+        , position_{p} {
+    }
+
+    bool operator!=(const segmentedIterator<T, C> & other) const {
+        return !(*this == other);
+    }
+
+    bool operator==(const segmentedIterator<T, C> & other) const {
+        return position_ == other.position_;
+    }
+
+    segmentedIterator & operator++() {
+        ++position_;
+        return *this;
+    }
+
+    T & operator*() const {
+        return chunks_[position_ / C][position_ % C];
+    }
+
+  private:
+    T * const * chunks_;
+    uint8_t     position_;
+};
+
+// array that grows by adding chunks of C entries, listed in a small directory inside the object
+// nothing is ever moved, so growing doesn't leave a trail of freed blocks behind and
+// entries keep their address. pick a power of 2 for C so indexing is a shift and a mask
+template <typename T, size_t C = ARRAY_INC_SIZE>
+class segmented_array {
+  public:
+    static_assert(C > 0 && C <= ARRAY_MAX_SIZE, "segmented_array chunks hold 1 to 255 entries");
+
+    static const uint8_t MAX_CHUNKS = (ARRAY_MAX_SIZE + C - 1) / C;
+
+    segmented_array()
+        : chunks_{}
+        , numChunks_(0)
+        , maxSize_(ARRAY_MAX_SIZE)
+        , size_(0) {
+    }
+
+    ~segmented_array() {
+        clear();
+        shrink_to_fit();
+    }
+
+    segmented_array(const segmented_array &) = delete;
+    segmented_array & operator=(const segmented_array &) = delete;
+
+    // constructs an entry after the last one, adding a chunk when needed
+    // returns its index or -1 when full or out of memory
+    template <class... Args>
+    int emplace(Args &&... args) {
+        if (size_ >= maxSize_ || (size_ >= numChunks_ * C && !add_chunk())) {
+            EMSESP_STATS(stats_.rejected_++);
+            return -1;
+        }
+        new (&chunks_[size_ / C][size_ % C]) T(std::forward<Args>(args)...);
+        EMSESP_STATS(stats_.pushes_++);
+        return size_++;
+    }
+
+    int push(const T & entry) {
+        return emplace(entry);
+    }
+
+    int push(T && entry) {
+        return emplace(std::move(entry));
+    }
+
+    T & operator[](uint8_t i) {
+#ifdef EMSESP_ASSERT
+        assert(i < size_);
+#endif
+        return chunks_[i / C][i % C];
+    }
+
+    const T & operator[](uint8_t i) const {
+#ifdef EMSESP_ASSERT
+        assert(i < size_);
+#endif
+        return chunks_[i / C][i % C];
+    }
+
+    // destroys all entries, the chunks stay allocated
+    void clear() {
+        for (uint8_t i = 0; i < size_; i++) {
+            (*this)[i].~T();
+        }
+        size_ = 0;
+    }
+
+    // frees the chunks that hold no entries
+    void shrink_to_fit() {
+        while (numChunks_ > (size_ + C - 1) / C) {
+            free(chunks_[--numChunks_]);
+            chunks_[numChunks_] = nullptr;
+        }
+    }
+
+    // Call when all entries have been added, the empty chunks are freed and push() and
+    // emplace() fail from now on. the last chunk keeps its unused entries, it is never reallocated
+    void freeze() {
+        shrink_to_fit();
+        maxSize_ = size_;
+    }
+
+    bool empty() const {
+        return (size_ == 0);
+    }
+
+    uint8_t size() const {
+        return (size_);
+    }
+
+    // number of entries in all chunks
+    uint16_t alloclen() const {
+        return numChunks_ * C;
+    }
+
+#if defined EMSESP_CONTAINER_STATS
+    const container_stats & stats() const {
+        return stats_;
+    }
+#endif
+
+    // iterators
+    segmentedIterator<T, C> begin() {
+        return segmentedIterator<T, C>(chunks_, 0);
+    }
+    segmentedIterator<T, C> end() {
+        return segmentedIterator<T, C>(chunks_, size_);
+    }
+
+    segmentedIterator<const T, C> begin() const {
+        return segmentedIterator<const T, C>(chunks_, 0);
+    }
+
+    segmentedIterator<const T, C> end() const {
+        return segmentedIterator<const T, C>(chunks_, size_);
+    }
+
+  private:
+    T *     chunks_[MAX_CHUNKS]; // the directory
+    uint8_t numChunks_;
+    uint8_t maxSize_;
+    uint8_t size_;
+#if defined EMSESP_CONTAINER_STATS
+    container_stats stats_;
+#endif
+
+    bool add_chunk() {
+        T * chunk = (T *)malloc(sizeof(T) * C);
+        if (chunk == nullptr)
+            return false;
+        chunks_[numChunks_++] = chunk;
+        EMSESP_STATS(stats_.resizes_++);
+#if defined EMSESP_CONTAINER_STATS
+        if (alloclen() > stats_.peak_alloc_) {
+            stats_.peak_alloc_ = alloclen();
+        }
+#endif
+        return true;
     }
 };
 
@@ -0,0 +1,107 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Delegate for "call method X on object Y", an object pointer and a stub, 8 bytes on the ESP8266
+ * The method is a template argument, so the stub calls it directly and the call is one indirect
+ * call with no heap. Replaces std::bind(&Device::method, this, _1, _2) and [this] lambdas
+ *
+ *   auto d = delegate<void(const char *, const int8_t)>::create<Boiler, &Boiler::set_mode>(&boiler);
+ *   auto f = delegate<void(const char *, const int8_t)>::create<&myFunction>();
+ */
+
+#ifndef EMSESP_DELEGATE_H
+#define EMSESP_DELEGATE_H
+
+#include <Arduino.h>
+
+#include <utility>
+
+namespace emsesp {
+
+template <typename Sig>
+class delegate;
+
+template <typename R, typename... Args>
+class delegate<R(Args...)> {
+  private:
+    using stub_type = R (*)(void * object, Args...);
+
+    void *    object_ = nullptr;
+    stub_type stub_   = nullptr;
+
+    delegate(void * object, stub_type stub)
+        : object_(object)
+        , stub_(stub) {
+    }
+
+    template <class T, R (T::*Method)(Args...)>
+    static R method_stub(void * object, Args... args) {
+        return (static_cast<T *>(object)->*Method)(std::forward<Args>(args)...);
+    }
+
+    template <class T, R (T::*Method)(Args...) const>
+    static R const_method_stub(void * object, Args... args) {
+        return (static_cast<const T *>(object)->*Method)(std::forward<Args>(args)...);
+    }
+
+    template <R (*Function)(Args...)>
+    static R function_stub(void * object __attribute__((unused)), Args... args) {
+        return Function(std::forward<Args>(args)...);
+    }
+
+  public:
+    delegate() = default;
+
+    // object->Method(args), object must live as long as the delegate
+    template <class T, R (T::*Method)(Args...)>
+    static delegate create(T * object) {
+        return delegate(object, &method_stub<T, Method>);
+    }
+
+    template <class T, R (T::*Method)(Args...) const>
+    static delegate create(const T * object) {
+        return delegate(const_cast<T *>(object), &const_method_stub<T, Method>);
+    }
+
+    // a free function, object is left empty
+    template <R (*Function)(Args...)>
+    static delegate create() {
+        return delegate(nullptr, &function_stub<Function>);
+    }
+
+    R operator()(Args... args) const {
+        return stub_(object_, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const {
+        return stub_ != nullptr;
+    }
+
+    bool operator==(const delegate & other) const {
+        return (object_ == other.object_) && (stub_ == other.stub_);
+    }
+
+    bool operator!=(const delegate & other) const {
+        return !(*this == other);
+    }
+};
+
+} // namespace emsesp
+
+#endif
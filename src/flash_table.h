@@ -0,0 +1,169 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Read-only container over a table in PROGMEM
+ * The table is built by the compiler, so nothing is registered at boot and no heap is used.
+ * Entries are copied out of flash with memcpy_P, so T must be trivially copyable.
+ * The only RAM is the overlay for what can change at runtime, 1 bit per entry for enabled
+ */
+
+#ifndef EMSESP_FLASH_TABLE_H
+#define EMSESP_FLASH_TABLE_H
+
+#include <Arduino.h>
+
+#include "containers.h"
+
+namespace emsesp {
+
+// number of entries in a MAKE_PSTR_LIST list, without the nullptr at the end
+template <size_t N>
+constexpr uint8_t flash_list_size(const __FlashStringHelper * const (&)[N]) {
+    return N - 1;
+}
+
+constexpr uint8_t flash_list_size(std::nullptr_t) {
+    return 0;
+}
+
+// walks a flash_table, gives back copies of the entries
+template <typename T>
+class flashIterator {
+  public:
+    flashIterator(const T * table, uint8_t p)
+        : table_{table}
+        , position_{p} {
+    }
+
+    bool operator!=(const flashIterator<T> & other) const {
+        return !(*this == other);
+    }
+
+    bool operator==(const flashIterator<T> & other) const {
+        return position_ == other.position_;
+    }
+
+    flashIterator & operator++() {
+        ++position_;
+        return *this;
+    }
+
+    T operator*() const {
+        T t;
+        memcpy_P(&t, &table_[position_], sizeof(T));
+        return t;
+    }
+
+  private:
+    const T * table_;
+    uint8_t   position_;
+};
+
+// N is the most entries the overlay has room for
+template <typename T, size_t N>
+class flash_table {
+  public:
+    static_assert(is_trivially_relocatable<T>::value, "flash_table entries are copied with memcpy_P");
+    static_assert(N > 0 && N <= UINT8_MAX, "flash_table holds 1 to 255 entries");
+
+    flash_table() {
+        memset(enabled_, 0xFF, sizeof(enabled_));
+    }
+
+    flash_table(const flash_table &) = delete;
+    flash_table & operator=(const flash_table &) = delete;
+
+    // table is an array of count entries in PROGMEM, everything past N is ignored
+    void begin(const T * table, size_t count) {
+        table_ = table;
+        size_  = (count < N) ? count : N;
+    }
+
+    template <size_t M>
+    void begin(const T (&table)[M]) {
+        begin(table, M);
+    }
+
+    // a copy of entry i, the table itself can't be written to
+    T operator[](uint8_t i) const {
+#ifdef EMSESP_ASSERT
+        assert(i < size_);
+#endif
+        T t;
+        memcpy_P(&t, &table_[i], sizeof(T));
+        return t;
+    }
+
+    bool enabled(uint8_t i) const {
+        return enabled_[i / 8] & (1 << (i % 8));
+    }
+
+    void enable(uint8_t i, bool on) {
+        if (on) {
+            enabled_[i / 8] |= (1 << (i % 8));
+        } else {
+            enabled_[i / 8] &= ~(1 << (i % 8));
+        }
+    }
+
+    bool empty() const {
+        return (size_ == 0);
+    }
+
+    uint8_t size() const {
+        return size_;
+    }
+
+    // the table is fixed at compile time, these let it stand in for the other containers
+    template <class... Args>
+    int emplace(Args &&...) {
+        EMSESP_STATS(stats_.rejected_++);
+        return -1;
+    }
+    void shrink_to_fit() {
+    }
+    void freeze() {
+    }
+
+#if defined EMSESP_CONTAINER_STATS
+    const container_stats & stats() const {
+        return stats_;
+    }
+#endif
+
+    flashIterator<T> begin() const {
+        return flashIterator<T>(table_, 0);
+    }
+
+    flashIterator<T> end() const {
+        return flashIterator<T>(table_, size_);
+    }
+
+  private:
+    const T * table_ = nullptr;
+    uint8_t   size_  = 0;
+    uint8_t   enabled_[(N + 7) / 8];
+#if defined EMSESP_CONTAINER_STATS
+    container_stats stats_;
+#endif
+};
+
+} // namespace emsesp
+
+#endif
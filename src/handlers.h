@@ -0,0 +1,129 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Handler index table
+ * Many commands call the same function, so the functions are listed once in a table in
+ * flash and a command only keeps the 1 byte index of its function (handler_id).
+ * The table is handed over with begin() before the first command is registered:
+ *
+ *   static const mqtt_cmd_c_function handlers_P[] PROGMEM = {myFunction, otherFunction};
+ *   mqtt_cmd_handlers::table().begin(handlers_P);
+ */
+
+#ifndef EMSESP_HANDLERS_H
+#define EMSESP_HANDLERS_H
+
+#include <Arduino.h>
+
+#include <utility>
+
+#if defined EMSESP_ASSERT
+#include <assert.h>
+#endif
+
+namespace emsesp {
+
+template <typename Sig>
+class handler_table;
+
+template <typename R, typename... Args>
+class handler_table<R(Args...)> {
+  public:
+    using function_p = R (*)(Args...);
+
+    static const uint8_t NO_HANDLER = 0xFF;
+
+    // table is an array of count function pointers, normally in PROGMEM
+    void begin(const function_p * table, size_t count) {
+        if (count > NO_HANDLER) {
+            count = NO_HANDLER; // 0xFF itself means no handler
+        }
+        table_ = table;
+        count_ = count;
+    }
+
+    template <size_t N>
+    void begin(const function_p (&table)[N]) {
+        begin(table, N);
+    }
+
+    // index of f in the table, NO_HANDLER if it isn't listed
+    uint8_t index_of(function_p f) const {
+        for (uint8_t i = 0; i < count_; i++) {
+            if (at(i) == f) {
+                return i;
+            }
+        }
+        return NO_HANDLER;
+    }
+
+    function_p at(uint8_t i) const {
+        return (i < count_) ? reinterpret_cast<function_p>(pgm_read_ptr(&table_[i])) : nullptr;
+    }
+
+    uint8_t size() const {
+        return count_;
+    }
+
+  private:
+    const function_p * table_ = nullptr;
+    uint8_t            count_ = 0;
+};
+
+// a function pointer of 1 byte, the index of the function in T::table()
+// T is a class with a static table() that returns the handler_table<Sig>
+template <typename Sig, class T>
+class handler_id;
+
+template <typename R, typename... Args, class T>
+class handler_id<R(Args...), T> {
+  public:
+    using function_p = R (*)(Args...);
+
+    handler_id() = default;
+
+    // looks up f, functions that are not in the table give an empty handler_id
+    handler_id(function_p f)
+        : id_(T::table().index_of(f)) {
+#ifdef EMSESP_ASSERT
+        assert(id_ != handler_table<R(Args...)>::NO_HANDLER);
+#endif
+    }
+
+    // an empty handler_id does nothing
+    R operator()(Args... args) const {
+        function_p f = T::table().at(id_);
+        return f ? f(std::forward<Args>(args)...) : R();
+    }
+
+    explicit operator bool() const {
+        return id_ != handler_table<R(Args...)>::NO_HANDLER;
+    }
+
+    uint8_t id() const {
+        return id_;
+    }
+
+  private:
+    uint8_t id_ = handler_table<R(Args...)>::NO_HANDLER;
+};
+
+} // namespace emsesp
+
+#endif
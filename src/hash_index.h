@@ -0,0 +1,170 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Open addressing hash index for looking up entries of a container by key
+ * Each slot is the 1 byte index of an entry plus 1 byte of its hash, so a lookup only
+ * compares keys when that byte matches. The hash of an entry is worked out once
+ * when it is added. Slots are probed one after the other.
+ * The slots are one block, sized by reserve() from the number of entries the container
+ * can hold, 2 bytes per slot, and taken through an allocator policy like the containers
+ */
+
+#ifndef EMSESP_HASH_INDEX_H
+#define EMSESP_HASH_INDEX_H
+
+#include <Arduino.h>
+
+#include <string.h>
+
+#include "containers.h"
+
+namespace emsesp {
+
+// FNV-1a of a command name and device type, the same for a string in RAM or in flash
+inline uint32_t hash_cmd(uint8_t device_type, const char * cmd) {
+    uint32_t h = 2166136261UL ^ device_type;
+    while (*cmd) {
+        h = (h ^ (uint8_t)*cmd++) * 16777619UL;
+    }
+    return h;
+}
+
+inline uint32_t hash_cmd_P(uint8_t device_type, const __FlashStringHelper * cmd) {
+    PGM_P    p = reinterpret_cast<PGM_P>(cmd);
+    uint32_t h = 2166136261UL ^ device_type;
+    uint8_t  c;
+    while ((c = pgm_read_byte(p++)) != 0) {
+        h = (h ^ c) * 16777619UL;
+    }
+    return h;
+}
+
+// A is an allocator policy with the interface of heap_allocator, e.g. arena_heap_allocator
+template <class A = heap_allocator>
+class hash_index : private A {
+  public:
+    static const uint8_t  NOT_FOUND = 0xFF;
+    static const uint16_t MAX_SLOTS = 256;
+
+    explicit hash_index(const A & alloc = A())
+        : A(alloc) {
+    }
+
+    ~hash_index() {
+        if (entry_ != nullptr) {
+            A::deallocate(entry_, 2 * slots_);
+        }
+    }
+
+    hash_index(const hash_index &) = delete;
+    hash_index & operator=(const hash_index &) = delete;
+
+    // room for entries, the smallest power of two with one slot more, at most 256 slots.
+    // only while the index is empty, false if there was no memory
+    bool reserve(size_t entries) {
+        if (size_ != 0) {
+            return false;
+        }
+        uint16_t slots = 2;
+        while (slots <= entries && slots < MAX_SLOTS) {
+            slots *= 2;
+        }
+        if (slots == slots_) {
+            return true;
+        }
+        if (entry_ != nullptr) {
+            A::deallocate(entry_, 2 * slots_);
+        }
+        entry_ = (uint8_t *)A::allocate(2 * slots);
+        if (entry_ == nullptr) {
+            slots_ = 0;
+            tag_   = nullptr;
+            return false;
+        }
+        slots_ = slots;
+        tag_   = entry_ + slots;
+        clear();
+        return true;
+    }
+
+    void clear() {
+        if (entry_ != nullptr) {
+            memset(entry_, NOT_FOUND, slots_);
+        }
+        size_ = 0;
+    }
+
+    // adds entry under hash, false when there is no free slot left or nothing was reserved
+    // one slot always stays free so a lookup of a missing key ends
+    bool insert(uint32_t hash, uint8_t entry) {
+        if (size_ + 1 >= slots_ || entry == NOT_FOUND) {
+            return false;
+        }
+        size_t i = hash & (slots_ - 1);
+        while (entry_[i] != NOT_FOUND) {
+            i = (i + 1) & (slots_ - 1);
+        }
+        entry_[i] = entry;
+        tag_[i]   = tag(hash);
+        size_++;
+        return true;
+    }
+
+    // the first entry stored under hash for which match(entry) is true, NOT_FOUND if there is none
+    template <typename M>
+    uint8_t find(uint32_t hash, M match) const {
+        if (slots_ == 0) {
+            return NOT_FOUND;
+        }
+        uint8_t t = tag(hash);
+        for (size_t i = hash & (slots_ - 1); entry_[i] != NOT_FOUND; i = (i + 1) & (slots_ - 1)) {
+            if (tag_[i] == t && match(entry_[i])) {
+                return entry_[i];
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    uint8_t size() const {
+        return size_;
+    }
+
+    size_t capacity() const {
+        return slots_ ? slots_ - 1 : 0;
+    }
+
+    // bytes taken for the slots
+    size_t alloclen() const {
+        return 2 * slots_;
+    }
+
+  private:
+    uint8_t * entry_ = nullptr; // index of the entry in the container, NOT_FOUND if the slot is free
+    uint8_t * tag_   = nullptr; // the top byte of its hash, in the same block after the entries
+    uint16_t  slots_ = 0;
+    uint8_t   size_  = 0;
+
+    static uint8_t tag(uint32_t hash) {
+        return hash >> 24;
+    }
+};
+
+} // namespace emsesp
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Struct layout inspector
+ * Describe the fields of a struct with EMSESP_LAYOUT_FIELD and layout_print() shows
+ * the offset of each field, the padding holes and the smallest order of the fields.
+ * EMSESP_SIZE_BUDGET stops the build when a struct grows past its budget
+ */
+
+#ifndef EMSESP_LAYOUT_H
+#define EMSESP_LAYOUT_H
+
+#include <Arduino.h>
+
+#include <stddef.h>
+
+// fails the build when type is bigger than its budget, with a budget for each data model:
+// bytes32 for 4 byte pointers (the ESP8266, ESP32 and "make ARCH=32"), bytes64 for a 64 bit host.
+// both are exact sizes, so a new field trips whichever build it is
+#define EMSESP_SIZE_BUDGET(type, bytes32, bytes64)                                                                                                             \
+    static_assert(sizeof(type) <= ((sizeof(void *) == 4) ? (bytes32) : (bytes64)),                                                                             \
+                  #type " is larger than its budget of " #bytes32 " bytes (" #bytes64 " on a 64 bit host)")
+
+// one entry in the field list of a struct, offsetof() needs all fields to be public
+#define EMSESP_LAYOUT_FIELD(type, field)                                                                                                                       \
+    { #field, offsetof(type, field), sizeof(((type *)nullptr)->field), alignof(decltype(((type *)nullptr)->field)) }
+
+namespace emsesp {
+
+static const uint8_t LAYOUT_MAX_FIELDS = 32;
+
+struct layout_field {
+    const char * name_;
+    size_t       offset_;
+    size_t       size_;
+    size_t       align_;
+};
+
+// size of the struct with the fields sorted by alignment, largest first
+// which leaves the least padding. order gets the index of the fields in that order
+inline size_t layout_optimal_size(const layout_field * fields, uint8_t count, size_t align, uint8_t * order) {
+    for (uint8_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+
+    // insertion sort, stable so equally aligned fields keep their order
+    for (uint8_t i = 1; i < count; i++) {
+        uint8_t j = i;
+        while (j > 0 && fields[order[j - 1]].align_ < fields[order[j]].align_) {
+            uint8_t t    = order[j];
+            order[j]     = order[j - 1];
+            order[j - 1] = t;
+            j--;
+        }
+    }
+
+    size_t size = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        const layout_field & f = fields[order[i]];
+        size                   = ((size + f.align_ - 1) / f.align_) * f.align_ + f.size_;
+    }
+    return ((size + align - 1) / align) * align;
+}
+
+// prints offset and size of every field, the holes in between and a better order
+inline void layout_print(Print & p, const char * name, size_t size, size_t align, const layout_field * fields, uint8_t count) {
+    char   s[100];
+    size_t end     = 0;
+    size_t padding = 0;
+
+    snprintf_P(s, sizeof(s), PSTR("%s: %u bytes, aligned %u"), name, (unsigned)size, (unsigned)align);
+    p.println(s);
+
+    for (uint8_t i = 0; i < count; i++) {
+        const layout_field & f = fields[i];
+        if (f.offset_ > end) {
+            snprintf_P(s, sizeof(s), PSTR("  %4u  %3u  (hole)"), (unsigned)end, (unsigned)(f.offset_ - end));
+            p.println(s);
+            padding += f.offset_ - end;
+        }
+        snprintf_P(s, sizeof(s), PSTR("  %4u  %3u  %s"), (unsigned)f.offset_, (unsigned)f.size_, f.name_);
+        p.println(s);
+        end = f.offset_ + f.size_;
+    }
+    if (size > end) {
+        snprintf_P(s, sizeof(s), PSTR("  %4u  %3u  (tail padding)"), (unsigned)end, (unsigned)(size - end));
+        p.println(s);
+        padding += size - end;
+    }
+
+    uint8_t order[LAYOUT_MAX_FIELDS];
+    if (count > LAYOUT_MAX_FIELDS) {
+        count = LAYOUT_MAX_FIELDS;
+    }
+    size_t optimal = layout_optimal_size(fields, count, align, order);
+
+    snprintf_P(s, sizeof(s), PSTR("  padding %u bytes, reordered %u bytes:"), (unsigned)padding, (unsigned)optimal);
+    p.print(s);
+    for (uint8_t i = 0; i < count; i++) {
+        p.print(" ");
+        p.print(fields[order[i]].name_);
+    }
+    p.println();
+}
+
+template <size_t N>
+void layout_print(Print & p, const char * name, size_t size, size_t align, const layout_field (&fields)[N]) {
+    layout_print(p, name, size, align, fields, N);
+}
+
+} // namespace emsesp
+
+#endif
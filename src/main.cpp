@@ -1,13 +1,12 @@
 #include <Arduino.h>
 
-#ifndef STANDALONE
 static uint32_t heap_start_   = ESP.getFreeHeap();
 static uint32_t old_free_heap = heap_start_;
-#endif
 
 static uint32_t mem_used = 0;
 
 #include "command.h"
+#include "pool.h"
 
 // clang-format off
 #define MAKE_PSTR(string_name, string_literal) static const char __pstr__##string_name[] __attribute__((__aligned__(sizeof(uint32_t)))) PROGMEM = string_literal;
@@ -28,6 +27,9 @@ MAKE_PSTR_LIST(v1, F_(off))
 MAKE_PSTR_LIST(v5, F_(off), F_(flow), F_(bufferedflow), F_(buffer), F_(layeredbuffer))
 MAKE_PSTR_LIST(v8, F_(off), F_(flow), F_(bufferedflow), F_(buffer), F_(layeredbuffer), F_(bufferedflow), F_(buffer), F_(layeredbuffer))
 
+// the results below are from an ESP8266. on the host "make bench && ./bench_matrix" runs all
+// containers and callback styles in one go and prints them as CSV (see bench/matrix.cpp)
+
 // std::vector
 // memory (since boot/of which is inplace) in bytes:
 // with 2 (C style function pointers)
@@ -99,6 +101,9 @@ MAKE_PSTR_LIST(v8, F_(off), F_(flow), F_(bufferedflow), F_(buffer), F_(layeredbu
 // CODE below
 //
 
+// kept outside setup() so loop() can report on it
+static emsesp::Command device(2);
+
 // call back functions
 void myFunction(const char * data, const int8_t id) {
     Serial.print(data);
@@ -106,6 +111,57 @@ void myFunction(const char * data, const int8_t id) {
     Serial.print(id);
 }
 
+#if STRUCT_NUM == 6
+// every function a command can call, listed once in flash
+static const emsesp::mqtt_cmd_c_function mqtt_handlers_P[] PROGMEM = {myFunction};
+#endif
+
+#if CONTAINER_NUM == 5
+MAKE_PSTR(hi, "hi")
+MAKE_PSTR(tfp, "tfp")
+
+// the whole command registry, placed in flash by the compiler
+static const emsesp::MQTTCmdFunction_P mqtt_cmds_P[] PROGMEM = {MQTT_CMD_P(1, 10, F_(hi), FL_(v5), F_(tfp), myFunction),
+                                                                MQTT_CMD_P(2, 10, F_(hi), FL_(v5), F_(tfp), myFunction),
+                                                                MQTT_CMD_P(3, 10, F_(hi), FL_(v8), F_(tfp), myFunction),
+                                                                MQTT_CMD_P(21, 10, F_(hi), FL_(v1), F_(tfp), myFunction),
+                                                                MQTT_CMD_P(22, 10, F_(hi), FL_(v1), F_(tfp), myFunction),
+                                                                MQTT_CMD_P(40, 10, F_(hi), nullptr, F_(tfp), myFunction),
+                                                                MQTT_CMD_P(41, 10, F_(hi), nullptr, F_(tfp), myFunction),
+                                                                MQTT_CMD_P(42, 10, F_(hi), nullptr, F_(tfp), myFunction)};
+#endif
+
+// a device with a command method, like the boiler or thermostat in EMS-ESP
+class MyDevice {
+  public:
+    void command(const char * data, const int8_t id) {
+        myFunction(data, id);
+    }
+};
+
+// the flash table is registered without it
+#if STRUCT_NUM == 5 && CONTAINER_NUM != 5
+static MyDevice my_device;
+#endif
+
+// the name the commands in setup() are registered under and the last device type
+// that has one, find() looks them up
+#if CONTAINER_NUM == 5
+#define FIND_CMD "tfp"
+#define FIND_LAST 42
+#elif STRUCT_NUM == 4
+#define FIND_CMD "tf4"
+#elif STRUCT_NUM == 5
+#define FIND_CMD "tf5"
+#elif STRUCT_NUM == 6
+#define FIND_CMD "tf6"
+#else
+#define FIND_CMD "tf3"
+#endif
+#ifndef FIND_LAST
+#define FIND_LAST NUM_ENTRIES
+#endif
+
 // abs of a signed 32-bit integer
 uint32_t myabs(const int32_t i) {
     return (i < 0 ? -i : i);
@@ -113,12 +169,11 @@ uint32_t myabs(const int32_t i) {
 
 // print out heap memory
 void show_mem(const char * note) {
-#ifndef STANDALONE
     static uint8_t old_heap_frag = 0;
     delay(100);
     yield(); // wait for CPU to catchup
     uint32_t free_heap = ESP.getFreeHeap();
-#if defined ESP8266
+#if defined(ESP8266) || defined(STANDALONE)
     uint8_t heap_frag = ESP.getHeapFragmentation();
 #else
     uint8_t heap_frag = 0;
@@ -136,9 +191,6 @@ void show_mem(const char * note) {
     old_free_heap = free_heap;
     old_heap_frag = heap_frag;
     Serial.println();
-#else
-    Serial.println(note);
-#endif
     Serial.flush();
 }
 
@@ -165,6 +217,25 @@ void print_queue(const char * s, emsesp::queue<uint8_t> & myQueue) {
     */
 }
 
+// a request bigger than the whole heap fails and leaves the heap as it was
+void heap_test() {
+    uint32_t free_before = ESP.getFreeHeap();
+
+    void * p = malloc(1UL << 20);
+    Serial.printf("malloc(1MB) = %s", p ? "a block, FAILED" : "nullptr, ok");
+    Serial.println();
+    free(p);
+
+    void * q = malloc(16);
+    void * r = realloc(q, 1UL << 20);
+    Serial.printf("realloc(16 bytes, 1MB) = %s", r ? "a block, FAILED" : "nullptr, ok");
+    Serial.println();
+    free(r ? r : q);
+
+    Serial.printf("free heap %s", (ESP.getFreeHeap() == free_before) ? "unchanged, ok" : "changed, FAILED");
+    Serial.println();
+}
+
 // local tests
 void queue_test() {
     // queue test
@@ -223,29 +294,117 @@ void queue_test() {
     Serial.println(myQueue3.pop());
     Serial.print("Popping, Got ");
     Serial.println(myQueue3.pop());
+
+    // queue test4 - wrap around the end of the buffer at both ends
+    Serial.println();
+    myQueue3.push(71);
+    myQueue3.push(81);
+    print_queue("wrapped", myQueue3);
+    myQueue3.pop();
+    myQueue3.pop();
+    myQueue3.push_front(1);
+    myQueue3.push_front(2);
+    print_queue("2 and 1 to front", myQueue3);
+    Serial.print("Popping back, Got ");
+    Serial.println(myQueue3.pop_back());
+    print_queue("wrapped", myQueue3);
+
+    // queue test5 - more than 255 entries with a uint16_t size type
+    Serial.println();
+    emsesp::queue<uint8_t, uint16_t> myQueue5 = emsesp::queue<uint8_t, uint16_t>(300);
+    for (uint16_t i = 0; i < 300; i++) {
+        myQueue5.push(i & 0xFF);
+    }
+    Serial.print("300 elements, size=");
+    Serial.print(myQueue5.size());
+    Serial.print(", last=");
+    Serial.println(myQueue5[299]);
+
+    emsesp::array<uint16_t, uint16_t> myArray5 = emsesp::array<uint16_t, uint16_t>(16);
+    for (uint16_t i = 0; i < 300; i++) {
+        myArray5.push(i);
+    }
+    Serial.print("array with 300 elements, size=");
+    Serial.print(myArray5.size());
+    Serial.print(", last=");
+    Serial.println(myArray5[299]);
+
+    // queue test6 - buffers taken from an arena instead of the heap
+    Serial.println();
+    emsesp::arena arena6;
+    arena6.begin(64);
+    emsesp::queue<uint8_t, uint8_t, emsesp::arena_allocator> myQueue6(10, emsesp::arena_allocator(arena6));
+    emsesp::array<uint16_t, uint8_t, emsesp::arena_allocator> myArray6(8, 16, 8, emsesp::arena_allocator(arena6));
+    for (uint8_t i = 0; i < 12; i++) {
+        myQueue6.push(i);
+        myArray6.push(i * 10);
+    }
+    Serial.print("arena queue size=");
+    Serial.print(myQueue6.size());
+    Serial.print(", array size=");
+    Serial.print(myArray6.size());
+    Serial.print(", last=");
+    Serial.print(myArray6[11]);
+    Serial.print(", arena: ");
+    arena6.printTo(Serial);
+    Serial.println();
+
+    // queue test7 - buffers from a pool, the queue fits in a block and the array grows out of it
+    emsesp::pool pool7(16, 4);
+    {
+        emsesp::queue<uint8_t, uint8_t, emsesp::pool_block_allocator> myQueue7(16, emsesp::pool_block_allocator(pool7));
+        emsesp::array<uint16_t, uint8_t, emsesp::pool_block_allocator> myArray7(4, 32, 8, emsesp::pool_block_allocator(pool7));
+        for (uint8_t i = 0; i < 12; i++) {
+            myQueue7.push(i);
+            myArray7.push(i * 10);
+        }
+        Serial.print("pool queue size=");
+        Serial.print(myQueue7.size());
+        Serial.print(", front=");
+        Serial.print(myQueue7.front());
+        Serial.print(", array size=");
+        Serial.print(myArray7.size());
+        Serial.print(", last=");
+        Serial.print(myArray7[11]);
+        Serial.print(", pool blocks used=");
+        Serial.print(pool7.used());
+        Serial.println();
+    }
+    Serial.print("pool blocks used after=");
+    Serial.print(pool7.used());
+    Serial.print(", ");
+    pool7.stats().printTo(Serial);
+    Serial.println();
     Serial.println();
 }
 
 void setup() {
-#ifndef STANDALONE
     Serial.begin(115200);
     Serial.println();
     Serial.printf("Starting heap: %d", heap_start_);
     Serial.println();
-#endif
     show_mem("boot");
 
-#ifndef STANDALONE
     uint32_t before_free_heap = ESP.getFreeHeap();
+
+#if CONTAINER_NUM == 4
+    // the command table, its 512 byte name index and some room for other startup data
+    emsesp::Command::startup_arena().begin(sizeof(emsesp::Command::MQTTCmdFunction) * NUM_ENTRIES + 1024);
 #endif
 
-    emsesp::Command device(2);
+#if STRUCT_NUM == 6
+    emsesp::mqtt_cmd_handlers::table().begin(mqtt_handlers_P);
+#endif
 
     device.reserve(NUM_ENTRIES, 255, 10); // grow by 10, max size 255
 
     // fill container
     show_mem("before");
 
+#if CONTAINER_NUM == 5
+    // nothing to build or copy, the table is already in flash
+    device.register_mqtt_cmds_P(mqtt_cmds_P);
+#else
     for (uint8_t i = 1; i <= NUM_ENTRIES; i++) {
 #if STRUCT_NUM == 3
         if (i < 20) {
@@ -272,20 +431,87 @@ void setup() {
         }
 
 
+#endif
+
+#if STRUCT_NUM == 4
+        // a lambda costs no more than the function pointer
+        auto f = [](const char * data, const int8_t id) { myFunction(data, id); };
+        if (i < 20) {
+            device.register_mqtt_cmd(i, 10, F("hi"), FL_(v5), F("tf4"), f);
+        } else if ((i > 20) && (i < 40)) {
+            device.register_mqtt_cmd(i, 10, F("hi"), FL_(v1), F("tf4"), f);
+        } else {
+            device.register_mqtt_cmd(i, 10, F("hi"), nullptr, F("tf4"), f);
+        }
+#endif
+
+#if STRUCT_NUM == 5
+        // instead of std::bind(&MyDevice::command, &my_device, _1, _2)
+        auto f = emsesp::Command::mqtt_cmdfunction_p::create<MyDevice, &MyDevice::command>(&my_device);
+        if (i < 20) {
+            device.register_mqtt_cmd(i, 10, F("hi"), FL_(v5), F("tf5"), f);
+        } else if ((i > 20) && (i < 40)) {
+            device.register_mqtt_cmd(i, 10, F("hi"), FL_(v1), F("tf5"), f);
+        } else {
+            device.register_mqtt_cmd(i, 10, F("hi"), nullptr, F("tf5"), f);
+        }
+#endif
+
+#if STRUCT_NUM == 6
+        // stored as the index of myFunction in mqtt_handlers_P
+        if (i < 20) {
+            device.register_mqtt_cmd(i, 10, F("hi"), FL_(v5), F("tf6"), myFunction);
+        } else if ((i > 20) && (i < 40)) {
+            device.register_mqtt_cmd(i, 10, F("hi"), FL_(v1), F("tf6"), myFunction);
+        } else {
+            device.register_mqtt_cmd(i, 10, F("hi"), nullptr, F("tf6"), myFunction);
+        }
 #endif
     }
+#endif
 
     Serial.println();
     show_mem("after");
 
-#ifndef STANDALONE
+    // no more commands, give back what wasn't used
+    device.freeze();
+#if CONTAINER_NUM == 4
+    emsesp::Command::startup_arena().seal();
+    Serial.print("startup arena: ");
+    emsesp::Command::startup_arena().printTo(Serial);
+    Serial.println();
+#endif
+    show_mem("frozen");
+
     uint32_t after_free_heap = ESP.getFreeHeap();
     device.print(before_free_heap - after_free_heap);
-#else
-    device.print(0);
+#if defined EMSESP_CONTAINER_STATS
+    device.show_stats();
 #endif
 
-    queue_test();
+    // look up commands by name like an incoming MQTT message, first and last take as long
+    for (uint8_t device_type : {1, FIND_LAST}) {
+        uint32_t start = ESP.getCycleCount();
+        int      i     = device.find(device_type, FIND_CMD);
+        uint32_t end   = ESP.getCycleCount();
+        Serial.printf("find(%d, " FIND_CMD ") = %d in %u cycles", device_type, i, end - start);
+        Serial.println();
+    }
+    Serial.printf("find(1, nope) = %d", device.find(1, "nope"));
+    Serial.println();
+#if CONTAINER_NUM == 5
+    // only the enabled bit in RAM changes, the entry in flash stays as it is
+    device.enable_cmd(1, FIND_CMD, false);
+    Serial.printf("disabled, find(1, " FIND_CMD ") = %d", device.find(1, FIND_CMD));
+    Serial.println();
+    device.enable_cmd(1, FIND_CMD, true);
+#endif
+
+    {
+        HEAP_TRACE_SCOPE("queue_test");
+        queue_test();
+    }
+    heap_test();
 
     // device.show_device_values();
 
@@ -293,12 +519,13 @@ void setup() {
 }
 
 void loop() {
-#ifndef STANDALONE
     // see if memory dissapears
     static uint32_t last_memcheck_ = 0;
     if (!last_memcheck_ || (millis() - last_memcheck_ > 10000)) { // 10 seconds
         last_memcheck_ = millis();
         show_mem("loop");
-    }
+#if defined EMSESP_CONTAINER_STATS
+        device.show_stats();
 #endif
+    }
 }
@@ -0,0 +1,294 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Slab pool for many objects of the same size
+ * All blocks come from one malloc() so they cost no umm_malloc header each and
+ * can't fragment the heap. Free blocks are kept in a list, a bitmap says which are in use.
+ * pool_allocator<T> lets std:: containers (e.g. std::list nodes) draw from a pool,
+ * pool_block_allocator does the same for emsesp::queue and emsesp::array
+ */
+
+#ifndef EMSESP_POOL_H
+#define EMSESP_POOL_H
+
+#include <Arduino.h>
+
+#include <new>
+#include <utility>
+
+#if defined EMSESP_ASSERT
+#include <assert.h>
+#endif
+
+namespace emsesp {
+
+class pool {
+  public:
+    struct pool_stats {
+        uint32_t allocs_ = 0;
+        uint32_t frees_  = 0;
+        uint32_t failed_ = 0; // allocate() calls when the pool was full
+        uint16_t peak_   = 0; // most blocks in use at the same time
+
+        size_t printTo(Print & p) const {
+            char s[80];
+            snprintf_P(s, sizeof(s), PSTR("allocs=%u frees=%u failed=%u peak=%u"), allocs_, frees_, failed_, peak_);
+            return p.print(s);
+        }
+    };
+
+    // count blocks of at least block_size bytes, in one allocation
+    // capacity() is 0 if that didn't fit on the heap
+    pool(size_t block_size, uint16_t count)
+        : block_size_(round_up(block_size))
+        , count_(count)
+        , used_(0)
+        , free_(0) {
+        mem_ = (uint8_t *)malloc(block_size_ * count_ + (count_ + 7) / 8);
+        if (mem_ == nullptr) {
+            count_ = 0;
+            return;
+        }
+        bitmap_ = mem_ + block_size_ * count_;
+        memset(bitmap_, 0, (count_ + 7) / 8);
+
+        // every free block holds the index of the next free one, count_ ends the list
+        for (uint16_t i = 0; i < count_; i++) {
+            next(i) = i + 1;
+        }
+    }
+
+    ~pool() {
+        free(mem_);
+    }
+
+    pool(const pool &) = delete;
+    pool & operator=(const pool &) = delete;
+
+    // a free block or nullptr when the pool is full
+    void * allocate() {
+        if (free_ >= count_) {
+            stats_.failed_++;
+            return nullptr;
+        }
+        uint16_t i = free_;
+        free_      = next(i);
+        bitmap_[i / 8] |= (1 << (i % 8));
+
+        used_++;
+        stats_.allocs_++;
+        if (used_ > stats_.peak_) {
+            stats_.peak_ = used_;
+        }
+        return block(i);
+    }
+
+    // p must come from allocate() of this pool
+    void deallocate(void * p) {
+        if (p == nullptr) {
+            return;
+        }
+        uint16_t i = ((uint8_t *)p - mem_) / block_size_;
+#ifdef EMSESP_ASSERT
+        assert(owns(p) && in_use(i));
+#endif
+        bitmap_[i / 8] &= ~(1 << (i % 8));
+        next(i) = free_;
+        free_   = i;
+
+        used_--;
+        stats_.frees_++;
+    }
+
+    bool owns(const void * p) const {
+        return (p >= mem_) && (p < mem_ + block_size_ * count_);
+    }
+
+    bool in_use(uint16_t i) const {
+        return bitmap_[i / 8] & (1 << (i % 8));
+    }
+
+    size_t block_size() const {
+        return block_size_;
+    }
+
+    uint16_t capacity() const {
+        return count_;
+    }
+
+    uint16_t used() const {
+        return used_;
+    }
+
+    const pool_stats & stats() const {
+        return stats_;
+    }
+
+  private:
+    uint8_t *  mem_;
+    uint8_t *  bitmap_;
+    size_t     block_size_;
+    uint16_t   count_;
+    uint16_t   used_;
+    uint16_t   free_; // first free block, count_ if none
+    pool_stats stats_;
+
+    // blocks are pointer aligned, and big enough to hold the free list index
+    static size_t round_up(size_t size) {
+        const size_t align = alignof(void *) > sizeof(uint16_t) ? alignof(void *) : sizeof(uint16_t);
+        return ((size + align - 1) / align) * align;
+    }
+
+    void * block(uint16_t i) const {
+        return mem_ + i * block_size_;
+    }
+
+    uint16_t & next(uint16_t i) const {
+        return *(uint16_t *)block(i);
+    }
+};
+
+// std:: allocator drawing single objects from a pool, anything that doesn't fit
+// in a block (arrays, or a pool that is full) goes to the heap as usual
+template <typename T>
+class pool_allocator {
+  public:
+    typedef T              value_type;
+    typedef T *            pointer;
+    typedef const T *      const_pointer;
+    typedef T &            reference;
+    typedef const T &      const_reference;
+    typedef size_t         size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind {
+        typedef pool_allocator<U> other;
+    };
+
+    explicit pool_allocator(pool & p)
+        : pool_(&p) {
+    }
+
+    template <typename U>
+    pool_allocator(const pool_allocator<U> & other)
+        : pool_(other.pool_) {
+    }
+
+    T * allocate(size_t n) {
+        void * p = nullptr;
+        if (n == 1 && sizeof(T) <= pool_->block_size()) {
+            p = pool_->allocate();
+        }
+        if (p == nullptr) {
+            p = malloc(n * sizeof(T));
+        }
+        return (T *)p;
+    }
+
+    void deallocate(T * p, size_t n __attribute__((unused))) {
+        if (pool_->owns(p)) {
+            pool_->deallocate(p);
+        } else {
+            free(p);
+        }
+    }
+
+    // needed by the C++11 containers of gcc 4.8
+    template <typename U, class... Args>
+    void construct(U * p, Args &&... args) {
+        new ((void *)p) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    void destroy(U * p) {
+        p->~U();
+    }
+
+    size_t max_size() const {
+        return SIZE_MAX / sizeof(T);
+    }
+
+    template <typename U>
+    bool operator==(const pool_allocator<U> & other) const {
+        return pool_ == other.pool_;
+    }
+
+    template <typename U>
+    bool operator!=(const pool_allocator<U> & other) const {
+        return pool_ != other.pool_;
+    }
+
+  private:
+    template <typename U>
+    friend class pool_allocator;
+
+    pool * pool_;
+};
+
+// allocator policy for emsesp::queue and emsesp::array, same interface as heap_allocator
+// a buffer that fits in a block comes from the pool, anything bigger (or a full pool) from the heap
+class pool_block_allocator {
+  public:
+    explicit pool_block_allocator(pool & p)
+        : pool_(&p) {
+    }
+
+    void * allocate(size_t size) {
+        void * p = nullptr;
+        if (size <= pool_->block_size()) {
+            p = pool_->allocate();
+        }
+        return p ? p : malloc(size);
+    }
+
+    void deallocate(void * p, size_t size __attribute__((unused))) {
+        if (pool_->owns(p)) {
+            pool_->deallocate(p);
+        } else {
+            free(p);
+        }
+    }
+
+    // nullptr (and p untouched) if it failed
+    void * reallocate(void * p, size_t size, size_t new_size) {
+        if (pool_->owns(p)) {
+            if (new_size <= pool_->block_size()) {
+                return p; // the block already has room
+            }
+        } else if (p == nullptr || new_size > pool_->block_size()) {
+            return realloc(p, new_size);
+        }
+        // moving between the pool and the heap
+        void * pn = allocate(new_size);
+        if (pn == nullptr) {
+            return nullptr;
+        }
+        memcpy(pn, p, (size < new_size) ? size : new_size);
+        deallocate(p, size);
+        return pn;
+    }
+
+  private:
+    pool * pool_;
+};
+
+} // namespace emsesp
+
+#endif
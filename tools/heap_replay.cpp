@@ -0,0 +1,342 @@
+/*
+ * EMS-ESP - https://github.com/proddy/EMS-ESP
+ * Copyright 2020  Paul Derbyshire
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replays an allocation trace recorded with HEAP_TRACE=<file> (see lib_standalone/heap_trace.h)
+ * against different allocator models and compares the resulting fragmentation.
+ *
+ *   heap_replay <trace> [--heap <bytes>] [--pool <slot size>x<slots>] [--arena <tag>:<bytes>]
+ *
+ * Models:
+ *   best-fit   umm_malloc as on the ESP8266
+ *   first-fit  umm_malloc with UMM_FIRST_FIT
+ *   pool       small allocations come from fixed size slots reserved at the start
+ *   arena      allocations made under the given tag are bump allocated and never freed
+ */
+
+#include "umm_heap.h"
+#include "heap_trace.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+class Model {
+  public:
+    Model(const char * name, size_t heap_size, bool first_fit = false)
+        : name_(name)
+        , arena_(heap_size + UmmHeap::BLOCK_SIZE)
+        , heap_(arena_.data(), arena_.size(), first_fit) {
+    }
+    virtual ~Model() = default;
+
+    virtual void * malloc(size_t size, uint8_t tag __attribute__((unused))) {
+        return heap_.malloc(size);
+    }
+    virtual void * realloc(void * ptr, size_t size, uint8_t tag __attribute__((unused))) {
+        return heap_.realloc(ptr, size);
+    }
+    virtual void free(void * ptr) {
+        heap_.free(ptr);
+    }
+
+    const char * name() const {
+        return name_.c_str();
+    }
+    UmmHeap & heap() {
+        return heap_;
+    }
+
+  protected:
+    std::string          name_;
+    std::vector<uint8_t> arena_;
+    UmmHeap              heap_;
+};
+
+// slots of the same size, taken from the heap in one go at the start
+class PoolModel : public Model {
+  public:
+    PoolModel(size_t heap_size, size_t slot_size, size_t slots)
+        : Model(("pool " + std::to_string(slot_size) + "x" + std::to_string(slots)).c_str(), heap_size)
+        , slot_size_(slot_size)
+        , used_(slots, false) {
+        pool_ = static_cast<uint8_t *>(heap_.malloc(slot_size * slots));
+    }
+
+    void * malloc(size_t size, uint8_t tag) override {
+        if (pool_ && size <= slot_size_) {
+            for (size_t i = 0; i < used_.size(); i++) {
+                if (!used_[i]) {
+                    used_[i] = true;
+                    return pool_ + i * slot_size_;
+                }
+            }
+        }
+        return Model::malloc(size, tag);
+    }
+
+    void * realloc(void * ptr, size_t size, uint8_t tag) override {
+        if (!in_pool(ptr)) {
+            return Model::realloc(ptr, size, tag);
+        }
+        if (size <= slot_size_) {
+            return ptr;
+        }
+        void * new_ptr = Model::malloc(size, tag);
+        if (new_ptr) {
+            free(ptr);
+        }
+        return new_ptr;
+    }
+
+    void free(void * ptr) override {
+        if (in_pool(ptr)) {
+            used_[(static_cast<uint8_t *>(ptr) - pool_) / slot_size_] = false;
+        } else {
+            Model::free(ptr);
+        }
+    }
+
+  private:
+    bool in_pool(void * ptr) const {
+        return pool_ && ptr >= pool_ && ptr < pool_ + slot_size_ * used_.size();
+    }
+
+    size_t            slot_size_;
+    std::vector<bool> used_;
+    uint8_t *         pool_;
+};
+
+// a block reserved at the start, everything allocated under the tag is packed into it
+class ArenaModel : public Model {
+  public:
+    ArenaModel(size_t heap_size, uint8_t tag, const char * tag_name, size_t size)
+        : Model(("arena " + std::string(tag_name) + ":" + std::to_string(size)).c_str(), heap_size)
+        , tag_(tag)
+        , size_(size) {
+        arena_start_ = static_cast<uint8_t *>(heap_.malloc(size));
+    }
+
+    void * malloc(size_t size, uint8_t tag) override {
+        size = (size + 3) & ~static_cast<size_t>(3);
+        if (arena_start_ && tag == tag_ && used_ + size <= size_) {
+            used_ += size;
+            return arena_start_ + used_ - size;
+        }
+        return Model::malloc(size, tag);
+    }
+
+    void * realloc(void * ptr, size_t size, uint8_t tag) override {
+        if (!in_arena(ptr)) {
+            return Model::realloc(ptr, size, tag);
+        }
+        return malloc(size, tag); // the old copy stays in the arena
+    }
+
+    void free(void * ptr) override {
+        if (!in_arena(ptr)) {
+            Model::free(ptr);
+        }
+    }
+
+  private:
+    bool in_arena(void * ptr) const {
+        return arena_start_ && ptr >= arena_start_ && ptr < arena_start_ + size_;
+    }
+
+    uint8_t   tag_;
+    size_t    size_;
+    size_t    used_ = 0;
+    uint8_t * arena_start_;
+};
+
+struct Result {
+    uint32_t start_free_    = 0; // before the pool or arena is reserved
+    uint32_t failures_      = 0;
+    uint32_t min_free_      = UINT32_MAX;
+    uint32_t min_max_block_ = UINT32_MAX;
+    uint8_t  max_frag_      = 0;
+};
+
+static void sample(Model & model, Result & result) {
+    UmmHeap & heap      = model.heap();
+    uint32_t  free_size = heap.free_size();
+    uint32_t  max_block = heap.max_block_size();
+    uint8_t   frag      = heap.fragmentation();
+    if (free_size < result.min_free_) {
+        result.min_free_ = free_size;
+    }
+    if (max_block < result.min_max_block_) {
+        result.min_max_block_ = max_block;
+    }
+    if (frag > result.max_frag_) {
+        result.max_frag_ = frag;
+    }
+}
+
+static Result replay(Model & model, uint32_t start_free, const std::vector<HeapTraceRecord> & records, size_t sample_every) {
+    Result              result;
+    std::vector<void *> blocks(UmmHeap::MAX_BLOCKS + 1, nullptr); // traced block -> model pointer
+    size_t              n = 0;
+
+    result.start_free_ = start_free;
+
+    for (const HeapTraceRecord & r : records) {
+        switch (r.op_) {
+        case HEAP_TRACE_MALLOC:
+            if (r.block_) {
+                blocks[r.block_] = model.malloc(r.size_, r.tag_);
+                result.failures_ += (blocks[r.block_] == nullptr);
+            }
+            break;
+        case HEAP_TRACE_REALLOC: {
+            void * old_ptr = r.old_ ? blocks[r.old_] : nullptr;
+            if (r.old_ && !old_ptr) {
+                break; // allocated before the trace started, or failed in this model
+            }
+            void * new_ptr = model.realloc(old_ptr, r.size_, r.tag_);
+            if (r.size_ && !new_ptr) {
+                result.failures_++;
+                break; // like realloc, the old block is still there
+            }
+            blocks[r.old_] = nullptr;
+            if (r.block_) {
+                blocks[r.block_] = new_ptr;
+            }
+            break;
+        }
+        case HEAP_TRACE_FREE:
+            if (blocks[r.block_]) {
+                model.free(blocks[r.block_]);
+                blocks[r.block_] = nullptr;
+            }
+            break;
+        default:
+            continue;
+        }
+
+        if ((++n % sample_every) == 0) {
+            sample(model, result);
+        }
+    }
+    sample(model, result);
+
+    return result;
+}
+
+static void print(Model & model, const Result & result) {
+    UmmHeap & heap = model.heap();
+    printf("%-28s %8u %9u %13u %8u %8u %13u %8u\n",
+           model.name(),
+           result.failures_,
+           result.start_free_ - result.min_free_,
+           result.min_max_block_,
+           result.max_frag_,
+           heap.free_size(),
+           heap.max_block_size(),
+           heap.fragmentation());
+}
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <trace> [--heap <bytes>] [--pool <slot size>x<slots>] [--arena <tag>:<bytes>]\n", argv[0]);
+        return 1;
+    }
+
+    FILE * f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    HeapTraceHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.magic_ != HEAP_TRACE_MAGIC || header.version_ != HEAP_TRACE_VERSION) {
+        fprintf(stderr, "%s: not a heap trace\n", argv[1]);
+        return 1;
+    }
+
+    // read all events, the tag names are collected on the way
+    std::vector<HeapTraceRecord> records;
+    std::vector<std::string>     tags(256);
+    HeapTraceRecord              r;
+    while (fread(&r, sizeof(r), 1, f) == 1) {
+        if (r.op_ == HEAP_TRACE_TAG) {
+            std::string name(r.size_, '\0');
+            if (fread(&name[0], 1, r.size_, f) != r.size_) {
+                break;
+            }
+            tags[r.tag_] = name;
+        } else {
+            records.push_back(r);
+        }
+    }
+    fclose(f);
+
+    size_t heap_size  = header.heap_size_;
+    size_t pool_slot  = 32;
+    size_t pool_slots = 64;
+    int    arena_tag  = -1;
+    size_t arena_size = 0;
+
+    for (int i = 2; i < argc - 1; i += 2) {
+        if (!strcmp(argv[i], "--heap")) {
+            heap_size = strtoul(argv[i + 1], nullptr, 0);
+        } else if (!strcmp(argv[i], "--pool")) {
+            sscanf(argv[i + 1], "%zux%zu", &pool_slot, &pool_slots);
+        } else if (!strcmp(argv[i], "--arena")) {
+            const char * colon = strchr(argv[i + 1], ':');
+            std::string  name  = colon ? std::string(argv[i + 1], colon - argv[i + 1]) : argv[i + 1];
+            arena_size         = colon ? strtoul(colon + 1, nullptr, 0) : 0;
+            for (size_t t = 1; t < tags.size(); t++) {
+                if (tags[t] == name) {
+                    arena_tag = t;
+                }
+            }
+            if (arena_tag < 0) {
+                fprintf(stderr, "tag %s is not in the trace\n", name.c_str());
+                return 1;
+            }
+        }
+    }
+
+    // a heap walk per event gets slow, so sample at most 10000 times
+    size_t sample_every = records.size() / 10000 + 1;
+
+    printf("%zu events, heap %zu bytes\n\n", records.size(), heap_size);
+    printf("%-28s %8s %9s %13s %8s %8s %13s %8s\n", "model", "failures", "peak_used", "min_max_block", "max_frag", "end_free", "end_max_block", "end_frag");
+
+    std::vector<Model *> models;
+    models.push_back(new Model("best-fit", heap_size));
+    models.push_back(new Model("first-fit", heap_size, true));
+    models.push_back(new PoolModel(heap_size, pool_slot, pool_slots));
+    if (arena_tag >= 0) {
+        models.push_back(new ArenaModel(heap_size, arena_tag, tags[arena_tag].c_str(), arena_size));
+    }
+
+    // the same for all models, the pool and arena are counted as used
+    uint32_t start_free = models[0]->heap().free_size();
+
+    for (Model * model : models) {
+        print(*model, replay(*model, start_free, records, sample_every));
+        delete model;
+    }
+
+    return 0;
+}